@@ -141,7 +141,8 @@ namespace drdemo {
         float min_t;
     };
 
-    bool BVH::Intersect(Ray const &ray, Interaction *const interaction) const {
+    template<typename T>
+    bool BVH::Intersect(TRay<T> const &ray, TInteraction<T> *const interaction) const {
         if (shapes.empty()) { return false; }
         // Local used interval
         float child_0_min, child_0_max;
@@ -155,7 +156,7 @@ namespace drdemo {
         bool hit = false;
 
         // Push the root node on the stack
-        todo[stack_ptr] = BVHTraversal(0, ray.t_min.GetValue());
+        todo[stack_ptr] = BVHTraversal(0, Tofloat(ray.t_min));
 
         while (stack_ptr >= 0) {
             // Pop node to work on
@@ -200,7 +201,8 @@ namespace drdemo {
         return hit;
     }
 
-    bool BVH::IntersectP(Ray const &ray) const {
+    template<typename T>
+    bool BVH::IntersectP(TRay<T> const &ray) const {
         if (shapes.empty()) { return false; }
         // Local used interval
         float child_0_min, child_0_max;
@@ -211,7 +213,7 @@ namespace drdemo {
         int32_t stack_ptr = 0;
 
         // Push the root node on the stack
-        todo[stack_ptr] = BVHTraversal(0, ray.t_min.GetValue());
+        todo[stack_ptr] = BVHTraversal(0, Tofloat(ray.t_min));
 
         while (stack_ptr >= 0) {
             // Pop node to work on
@@ -256,6 +258,15 @@ namespace drdemo {
         return false;
     }
 
+    // Instantiate the traversal for the Float and the passive rays
+    template bool BVH::Intersect(Ray const &ray, Interaction *interaction) const;
+
+    template bool BVH::Intersect(Rayf const &ray, Interactionf *interaction) const;
+
+    template bool BVH::IntersectP(Ray const &ray) const;
+
+    template bool BVH::IntersectP(Rayf const &ray) const;
+
 //    BBOX BVH::BBox() const {
 //        return flat_tree[0].bbox;
 //    }
@@ -51,11 +51,14 @@ namespace drdemo {
         // Shape methods
         // bool Intersect(Ray const &ray, Interaction *const interaction) const override;
 
-        bool Intersect(Ray const &ray, Interaction *interaction) const;
+        // Intersect the BVH with a Float or a passive ray
+        template<typename T>
+        bool Intersect(TRay<T> const &ray, TInteraction<T> *interaction) const;
 
         // bool IntersectP(Ray const &ray) const override;
 
-        bool IntersectP(Ray const &ray) const;
+        template<typename T>
+        bool IntersectP(TRay<T> const &ray) const;
 
         inline BBOX BBox() const {
             return flat_tree[0].bbox;
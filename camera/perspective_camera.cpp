@@ -45,6 +45,12 @@ namespace drdemo {
     }
 
     Ray PerspectiveCamera::GenerateRay(size_t i, size_t j, float s_x, float s_y) const {
+        const Rayf ray = GenerateRayf(i, j, s_x, s_y);
+
+        return Ray(ToFloat(ray.o), ToFloat(ray.d));
+    }
+
+    Rayf PerspectiveCamera::GenerateRayf(size_t i, size_t j, float s_x, float s_y) const {
         // Convert pixel position to homogeneous coordinates
         // float p_h[3] = {i + s_x, j + s_y, 1.f};
         const Vector3f p_h(i + s_x, j + s_y, 1.f);
@@ -58,7 +64,7 @@ namespace drdemo {
 //        view_dir.z = p_w[2] - c_w[2];
         view_dir = Normalize(view_dir);
 
-        return Ray(ToFloat(c_w), ToFloat(view_dir));
+        return Rayf(c_w, view_dir);
     }
 
     Vector3F PerspectiveCamera::LookDir() const {
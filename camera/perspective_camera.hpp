@@ -36,6 +36,8 @@ namespace drdemo {
 
         Ray GenerateRay(size_t i, size_t j, float s_x, float s_y) const override;
 
+        Rayf GenerateRayf(size_t i, size_t j, float s_x, float s_y) const override;
+
         Vector3F LookDir() const override; // TODO
     };
 
@@ -30,6 +30,15 @@ namespace drdemo {
         return Ray(eye_world, Normalize(s));
     }
 
+    Rayf PinholeCamera::GenerateRayf(size_t i, size_t j, float s_x, float s_y) const {
+        // Compute point on view plane
+        float view_plane_x = left + (right - left) * (i + s_x) / static_cast<float>(width);
+        float view_plane_y = top - (top - bottom) * (j + s_y) / static_cast<float>(height);
+        Vector3f s = view_plane_x * Tofloat(u) + view_plane_y * Tofloat(v) - Tofloat(w);
+
+        return Rayf(Tofloat(eye_world), Normalize(s));
+    }
+
     Vector3F PinholeCamera::LookDir() const {
         return -w;
     }
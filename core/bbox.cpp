@@ -57,20 +57,28 @@ namespace drdemo {
         return 2.f * (extent.x * extent.y + extent.x * extent.z + extent.y * extent.z);
     }
 
-    bool BBOX::Intersect(const Ray &ray, float *const t_min, float *const t_max) const {
+    template<typename T>
+    bool BBOX::Intersect(const TRay<T> &ray, float *const t_min, float *const t_max) const {
+        const Vector3f o = Tofloat(ray.o);
+        const Vector3f d = Tofloat(ray.d);
         // Find minimum intersection
-        float tx_min = (bounds[ray.sign[0]].x - ray.o.x.GetValue()) / ray.d.x.GetValue();
-        float ty_min = (bounds[ray.sign[1]].y - ray.o.y.GetValue()) / ray.d.y.GetValue();
-        float tz_min = (bounds[ray.sign[2]].z - ray.o.z.GetValue()) / ray.d.z.GetValue();
+        float tx_min = (bounds[ray.sign[0]].x - o.x) / d.x;
+        float ty_min = (bounds[ray.sign[1]].y - o.y) / d.y;
+        float tz_min = (bounds[ray.sign[2]].z - o.z) / d.z;
         // Find maximum intersection
-        float tx_max = (bounds[1 - ray.sign[0]].x - ray.o.x.GetValue()) / ray.d.x.GetValue();
-        float ty_max = (bounds[1 - ray.sign[1]].y - ray.o.y.GetValue()) / ray.d.y.GetValue();
-        float tz_max = (bounds[1 - ray.sign[2]].z - ray.o.z.GetValue()) / ray.d.z.GetValue();
+        float tx_max = (bounds[1 - ray.sign[0]].x - o.x) / d.x;
+        float ty_max = (bounds[1 - ray.sign[1]].y - o.y) / d.y;
+        float tz_max = (bounds[1 - ray.sign[2]].z - o.z) / d.z;
 
-        *t_min = std::max(tz_min, std::max(ty_min, std::max(tx_min, ray.t_min.GetValue())));
-        *t_max = std::min(tz_max, std::min(ty_max, std::min(tx_max, ray.t_max.GetValue())));
+        *t_min = std::max(tz_min, std::max(ty_min, std::max(tx_min, Tofloat(ray.t_min))));
+        *t_max = std::min(tz_max, std::min(ty_max, std::min(tx_max, Tofloat(ray.t_max))));
 
         return *t_min <= *t_max;
     }
 
+    // Instantiate the intersection for the Float and the passive rays
+    template bool BBOX::Intersect(const Ray &ray, float *t_min, float *t_max) const;
+
+    template bool BBOX::Intersect(const Rayf &ray, float *t_min, float *t_max) const;
+
 } // drdemo namespace
\ No newline at end of file
@@ -69,7 +69,8 @@ namespace drdemo {
         float Surface() const;
 
         // Compute intersection with ray
-        bool Intersect(const Ray &ray, float *t_min, float *t_max) const;
+        template<typename T>
+        bool Intersect(const TRay<T> &ray, float *t_min, float *t_max) const;
     };
 
 } // drdemo namespace
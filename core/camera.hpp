@@ -17,6 +17,9 @@ namespace drdemo {
         // Generate a ray given a pixel coordinates and a sample coordinates
         virtual Ray GenerateRay(size_t i, size_t j, float s_x, float s_y) const = 0;
 
+        // Generate a passive ray, used when nothing is recorded on the tape
+        virtual Rayf GenerateRayf(size_t i, size_t j, float s_x, float s_y) const = 0;
+
         // Camera look direction
         virtual Vector3F LookDir() const = 0;
     };
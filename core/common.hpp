@@ -5,6 +5,8 @@
 #ifndef DRDEMO_COMMON_HPP
 #define DRDEMO_COMMON_HPP
 
+#include <cmath>
+
 namespace drdemo {
 
     // Small tolerance value used in the ray tracing part
@@ -28,6 +30,9 @@ namespace drdemo {
         return static_cast<int>((static_cast<T>(0) < v) - (v < static_cast<T>(0)));
     }
 
+    // Sqrt of float, so that templated code can call Sqrt on any scalar type
+    inline float Sqrt(float v) { return std::sqrt(v); }
+
     // Convert radians to degree
     template<typename T>
     inline T RadToDeg(T const &rad) { return (rad * (180.f * M_1_PI)); }
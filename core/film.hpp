@@ -30,6 +30,9 @@ namespace drdemo {
         // Add sample to the film
         virtual bool AddSample(Spectrum const &s, size_t i, size_t j, float s_x, float s_y) = 0;
 
+        // Add sample computed on the passive render path
+        virtual bool AddSample(Spectrumf const &s, size_t i, size_t j, float s_x, float s_y) = 0;
+
         // Get final film color at given pixel
         virtual Spectrum const &At(size_t i, size_t j) const = 0;
 
@@ -35,6 +35,8 @@ namespace drdemo {
         Vector3(Vector3<T> const &other)
                 : x(other.x), y(other.y), z(other.z) {}
 
+        Vector3<T> &operator=(Vector3<T> const &other) = default;
+
         // Index element access
         T const &operator[](int i) const {
             if (i == 0) { return x; }
@@ -112,14 +114,18 @@ namespace drdemo {
         return v.x * v.x + v.y * v.y + v.z * v.z;
     }
 
+    // Squared length of Float vector, recorded as a single node
+    template<>
+    inline Float LengthSquared<Float>(Vector3<Float> const &v) {
+        const float partials[3] = {2.f * v.x.GetValue(), 2.f * v.y.GetValue(), 2.f * v.z.GetValue()};
+        Float const *const parents[3] = {&v.x, &v.y, &v.z};
+        return FusedNode(0.5f * (partials[0] * v.x.GetValue() + partials[1] * v.y.GetValue() +
+                                 partials[2] * v.z.GetValue()), 3, partials, parents);
+    }
+
     // Length of Vector3
     template<typename T>
     inline T Length(Vector3<T> const &v) {
-        return std::sqrt(LengthSquared(v));
-    }
-
-    template<>
-    inline Float Length<Float>(Vector3<Float> const &v) {
         return Sqrt(LengthSquared(v));
     }
 
@@ -135,6 +141,16 @@ namespace drdemo {
         return a.x * b.x + a.y * b.y + a.z * b.z;
     }
 
+    // Dot product of Float vectors, recorded as a single node
+    template<>
+    inline Float Dot<Float>(Vector3<Float> const &a, Vector3<Float> const &b) {
+        const float partials[6] = {b.x.GetValue(), b.y.GetValue(), b.z.GetValue(),
+                                   a.x.GetValue(), a.y.GetValue(), a.z.GetValue()};
+        Float const *const parents[6] = {&a.x, &a.y, &a.z, &b.x, &b.y, &b.z};
+        return FusedNode(partials[0] * partials[3] + partials[1] * partials[4] + partials[2] * partials[5],
+                         6, partials, parents);
+    }
+
     template<typename T>
     inline T AbsDot(Vector3<T> const &a, Vector3<T> const &b) {
         return std::abs(Dot(a, b));
@@ -142,7 +158,7 @@ namespace drdemo {
 
     template<>
     inline Float AbsDot<Float>(Vector3<Float> const &a, Vector3<Float> const &b) {
-        return Abs(a.x * b.x + a.y * b.y + a.z * b.z);
+        return Abs(Dot(a, b));
     }
 
     // Cross product
@@ -161,6 +177,26 @@ namespace drdemo {
         return v / length;
     }
 
+    // Normalize Float vector, each component is recorded as a single node depending on the three input ones
+    template<>
+    inline Vector3<Float> Normalize<Float>(Vector3<Float> const &v) {
+        const float v_f[3] = {v.x.GetValue(), v.y.GetValue(), v.z.GetValue()};
+        const float length = std::sqrt(v_f[0] * v_f[0] + v_f[1] * v_f[1] + v_f[2] * v_f[2]);
+        assert(length != 0.f);
+        const float inv_length = 1.f / length;
+        const float n[3] = {v_f[0] * inv_length, v_f[1] * inv_length, v_f[2] * inv_length};
+        Float const *const parents[3] = {&v.x, &v.y, &v.z};
+        // Partial derivatives of n_i with respect to v_j are (delta_ij - n_i * n_j) / length
+        float partials[3][3];
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 3; ++j) {
+                partials[i][j] = ((i == j ? 1.f : 0.f) - n[i] * n[j]) * inv_length;
+            }
+        }
+        return Vector3<Float>(FusedNode(n[0], 3, partials[0], parents), FusedNode(n[1], 3, partials[1], parents),
+                              FusedNode(n[2], 3, partials[2], parents));
+    }
+
     // Minimum vector between two
     template<typename T>
     inline Vector3<T> Min(Vector3<T> const &v1, Vector3<T> const &v2) {
@@ -193,6 +229,13 @@ namespace drdemo {
         return Vector3<Float>(v.x, v.y, v.z);
     }
 
+    // Identity conversions, allow to use Tofloat in code templated on the scalar type
+    inline float Tofloat(Float const &v) { return v.GetValue(); }
+
+    inline float Tofloat(float v) { return v; }
+
+    inline Vector3<float> const &Tofloat(Vector3<float> const &v) { return v; }
+
     // Print vector
     template<typename T>
     std::ostream &operator<<(std::ostream &os, Vector3<T> const &v) {
@@ -203,34 +246,87 @@ namespace drdemo {
 
     /**
      * Ray class, attribute are made public for practice
+     *
+     * The scalar type is Float on the differentiable render path and float on the passive one, used when nothing
+     * needs to be recorded on the tape
      */
-    class Ray {
+    template<typename T>
+    class TRay {
     public:
         // Origin
-        Vector3F o;
+        Vector3<T> o;
 
         // Direction, NOT forced to be normalized
-        Vector3F d;
+        Vector3<T> d;
 
         // Minimum and maximum parameter of the ray
-        mutable Float t_min;
-        mutable Float t_max;
+        mutable T t_min;
+        mutable T t_max;
 
         // Ray direction sign
         int sign[3];
 
         // Constructor
-        Ray() : t_min(EPS), t_max(INFINITY) {}
+        TRay() : t_min(EPS), t_max(INFINITY) {}
 
-        Ray(Vector3F const &o, Vector3F const &d, float t_min = EPS, float t_max = INFINITY)
+        TRay(Vector3<T> const &o, Vector3<T> const &d, float t_min = EPS, float t_max = INFINITY)
                 : o(o), d(d), t_min(t_min), t_max(t_max) {
             sign[0] = d.x < 0.f;
             sign[1] = d.y < 0.f;
             sign[2] = d.z < 0.f;
         }
 
-        template<typename T>
-        inline Vector3F operator()(T const &t) const { return o + t * d; }
+        template<typename U>
+        inline Vector3<T> operator()(U const &t) const { return o + t * d; }
+    };
+
+    // Define common ray types
+    using Ray = TRay<Float>;
+    using Rayf = TRay<float>;
+
+    // Convert Float ray to float ray
+    inline Rayf Tofloat(Ray const &ray) {
+        return Rayf(Tofloat(ray.o), Tofloat(ray.d), ray.t_min.GetValue(), ray.t_max.GetValue());
+    }
+
+    // Convert float ray to Float ray
+    inline Ray ToFloat(Rayf const &ray) {
+        return Ray(ToFloat(ray.o), ToFloat(ray.d), ray.t_min, ray.t_max);
+    }
+
+    // Number of rays traced together by the packet routines
+    const int RAY_PACKET_SIZE = 8;
+
+    /**
+     * Packet of passive rays traced together, used for the coherent camera rays when nothing is recorded on the tape.
+     * The components are stored lane by lane, so the same operation on all the rays is a loop over contiguous floats
+     * that the compiler can vectorize. Only the first size lanes are used
+     */
+    struct RayPacketf {
+        // Origins and directions, o[axis][lane]
+        float o[3][RAY_PACKET_SIZE];
+        float d[3][RAY_PACKET_SIZE];
+        // Minimum and maximum parameter of the rays, like in TRay the intersection routines shorten t_max to the hits
+        float t_min[RAY_PACKET_SIZE];
+        mutable float t_max[RAY_PACKET_SIZE];
+        // Number of rays in the packet
+        int size = 0;
+
+        // Store a ray in a lane
+        inline void Set(int lane, Rayf const &ray) {
+            for (int axis = 0; axis < 3; axis++) {
+                o[axis][lane] = ray.o[axis];
+                d[axis][lane] = ray.d[axis];
+            }
+            t_min[lane] = ray.t_min;
+            t_max[lane] = ray.t_max;
+        }
+
+        // Get the ray of a lane
+        inline Rayf Get(int lane) const {
+            return Rayf(Vector3f(o[0][lane], o[1][lane], o[2][lane]), Vector3f(d[0][lane], d[1][lane], d[2][lane]),
+                        t_min[lane], t_max[lane]);
+        }
     };
 
 } // drdemo namespace
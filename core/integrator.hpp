@@ -26,6 +26,18 @@ namespace drdemo {
         // Compute incoming radiance for given ray
         virtual Spectrum
         IncomingRadiance(Ray const &ray, Scene const &scene, const CameraInterface &camera, size_t depth) const = 0;
+
+        // Passive version of IncomingRadiance, used when nothing is recorded on the tape
+        virtual Spectrumf
+        IncomingRadiance(Rayf const &ray, Scene const &scene, const CameraInterface &camera, size_t depth) const = 0;
+
+        // Passive incoming radiance of the rays of a packet, stored in L. The default implementation goes ray by ray
+        virtual void IncomingRadiancePacket(RayPacketf const &packet, Scene const &scene, const CameraInterface &camera,
+                                            size_t depth, Spectrumf *L) const {
+            for (int lane = 0; lane < packet.size; lane++) {
+                L[lane] = IncomingRadiance(packet.Get(lane), scene, camera, depth);
+            }
+        }
     };
 
 } // drdemo namespace
@@ -11,24 +11,52 @@
 namespace drdemo {
 
     /**
-     * Define Interaction class, used to move around the information of the interaction between a Ray and a Shape
+     * Define Interaction class, used to move around the information of the interaction between a Ray and a Shape.
+     * Templated on the scalar type like TRay
      */
-    class Interaction {
+    template<typename T>
+    class TInteraction {
     public:
-        Interaction() = default;
+        TInteraction() = default;
 
         // Hit point
-        Vector3F p;
+        Vector3<T> p;
         // Normal
-        Vector3F n;
+        Vector3<T> n;
         // Intersection parameter
-        Float t;
+        T t;
         // Outgoing direction, in world space
-        Vector3F wo;
+        Vector3<T> wo;
         // Albedo value
-        Spectrum albedo;
+        TSpectrum<T> albedo;
     };
 
+    // Define common interaction types
+    using Interaction = TInteraction<Float>;
+    using Interactionf = TInteraction<float>;
+
+    // Convert Float interaction to float interaction
+    inline Interactionf Tofloat(Interaction const &interaction) {
+        Interactionf converted;
+        converted.p = Tofloat(interaction.p);
+        converted.n = Tofloat(interaction.n);
+        converted.t = interaction.t.GetValue();
+        converted.wo = Tofloat(interaction.wo);
+        converted.albedo = Tofloat(interaction.albedo);
+        return converted;
+    }
+
+    // Convert float interaction to Float interaction
+    inline Interaction ToFloat(Interactionf const &interaction) {
+        Interaction converted;
+        converted.p = ToFloat(interaction.p);
+        converted.n = ToFloat(interaction.n);
+        converted.t = interaction.t;
+        converted.wo = ToFloat(interaction.wo);
+        converted.albedo = Spectrum(interaction.albedo.r, interaction.albedo.g, interaction.albedo.b);
+        return converted;
+    }
+
 } // drdemo namespace
 
 #endif //DRDEMO_INTERACTION_HPP
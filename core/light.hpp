@@ -39,6 +39,10 @@ namespace drdemo {
         // Sample incoming light at a given Interaction, returns incoming radiance and fills sampling parameters
         virtual Spectrum
         SampleLi(const Interaction &interaction, float u0, float u1, Vector3F *wi, Float *pdf) const = 0;
+
+        // Passive version of SampleLi, used when nothing is recorded on the tape
+        virtual Spectrumf
+        SampleLi(const Interactionf &interaction, float u0, float u1, Vector3f *wi, float *pdf) const = 0;
     };
 
 } // drdemo namespace
@@ -18,6 +18,10 @@ namespace drdemo {
     public:
         // Render scene given a Film, a Scene and a Camera
         virtual void RenderImage(Film *film, Scene const &scene, CameraInterface const &camera) const = 0;
+
+        // Render only the rows of the image in [row_start, row_end), used to split the rendering between threads
+        virtual void RenderRows(Film *film, Scene const &scene, CameraInterface const &camera,
+                                size_t row_start, size_t row_end) const = 0;
     };
 
 } // drdemo namespace
@@ -33,10 +33,12 @@ namespace drdemo {
 //        lights.at(index)->Enable();
 //    }
 
-    bool Scene::Intersect(Ray const &ray, Interaction *const interaction) const {
+    // Loop over all shapes and look for closest interaction
+    template<typename T>
+    static bool IntersectShapes(std::vector<std::shared_ptr<Shape> > const &shapes, TRay<T> const &ray,
+                                TInteraction<T> *const interaction) {
         // Hit flag
         bool hit = false;
-        // Loop over all shapes and look for closest interaction
         for (auto const &shape : shapes) {
             if (shape->Intersect(ray, interaction)) {
                 hit = true;
@@ -46,7 +48,8 @@ namespace drdemo {
         return hit;
     }
 
-    bool Scene::IntersectP(Ray const &ray) const {
+    template<typename T>
+    static bool IntersectShapesP(std::vector<std::shared_ptr<Shape> > const &shapes, TRay<T> const &ray) {
         for (auto const &shape : shapes) {
             if (shape->IntersectP(ray)) { return true; }
         }
@@ -54,4 +57,31 @@ namespace drdemo {
         return false;
     }
 
+    bool Scene::Intersect(Ray const &ray, Interaction *const interaction) const {
+        return IntersectShapes(shapes, ray, interaction);
+    }
+
+    bool Scene::IntersectP(Ray const &ray) const {
+        return IntersectShapesP(shapes, ray);
+    }
+
+    bool Scene::Intersect(Rayf const &ray, Interactionf *const interaction) const {
+        return IntersectShapes(shapes, ray, interaction);
+    }
+
+    bool Scene::IntersectP(Rayf const &ray) const {
+        return IntersectShapesP(shapes, ray);
+    }
+
+    void Scene::IntersectPacket(RayPacketf const &packet, Interactionf *const interactions, bool *const hits) const {
+        for (int lane = 0; lane < packet.size; lane++) { hits[lane] = false; }
+        // Like IntersectShapes each shape only fills the interactions of the lanes it hits before their t_max, which
+        // it shortens, so the interactions left are the closest ones
+        bool shape_hits[RAY_PACKET_SIZE];
+        for (auto const &shape : shapes) {
+            shape->IntersectPacket(packet, interactions, shape_hits);
+            for (int lane = 0; lane < packet.size; lane++) { hits[lane] = hits[lane] || shape_hits[lane]; }
+        }
+    }
+
 } // drdemo namespace
\ No newline at end of file
@@ -54,6 +54,14 @@ namespace drdemo {
         bool Intersect(Ray const &ray, Interaction *interaction) const;
 
         bool IntersectP(Ray const &ray) const;
+
+        // Passive versions, used when nothing is recorded on the tape
+        bool Intersect(Rayf const &ray, Interactionf *interaction) const;
+
+        bool IntersectP(Rayf const &ray) const;
+
+        // Intersect the rays of a packet, same as the passive Intersect for each lane
+        void IntersectPacket(RayPacketf const &packet, Interactionf *interactions, bool *hits) const;
     };
 
 } // drdemo namespace
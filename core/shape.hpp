@@ -23,6 +23,32 @@ namespace drdemo {
         // Check for intersection between Ray and the shape
         virtual bool IntersectP(Ray const &ray) const = 0;
 
+        // Passive versions of the intersection routines, used when nothing is recorded on the tape. The default
+        // implementation goes through the Float ones, shapes should override them with a float only path
+        virtual bool Intersect(Rayf const &ray, Interactionf *interaction) const {
+            const Ray ray_F = ToFloat(ray);
+            Interaction interaction_F;
+            if (!Intersect(ray_F, &interaction_F)) { return false; }
+            ray.t_max = ray_F.t_max.GetValue();
+            *interaction = Tofloat(interaction_F);
+            return true;
+        }
+
+        virtual bool IntersectP(Rayf const &ray) const {
+            return IntersectP(ToFloat(ray));
+        }
+
+        // Intersect the rays of a packet, hits[lane] tells if the ray of the lane hits the shape before
+        // packet.t_max[lane] and only then interactions[lane] is filled and packet.t_max[lane] set to the hit. The
+        // default implementation intersects the rays one by one
+        virtual void IntersectPacket(RayPacketf const &packet, Interactionf *interactions, bool *hits) const {
+            for (int lane = 0; lane < packet.size; lane++) {
+                const Rayf ray = packet.Get(lane);
+                hits[lane] = Intersect(ray, &interactions[lane]);
+                if (hits[lane]) { packet.t_max[lane] = ray.t_max; }
+            }
+        }
+
         // Compute Shape BBOX
         virtual BBOX BBox() const = 0;
 
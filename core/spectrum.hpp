@@ -10,38 +10,38 @@
 namespace drdemo {
 
     /**
-     * Define Spectrum class used for radiance computations
+     * Define Spectrum class used for radiance computations, templated on the scalar type like TRay
      */
-    class Spectrum {
+    template<typename T>
+    class TSpectrum {
     public:
-        Float r, g, b;
+        T r, g, b;
 
         // Constructors
-        Spectrum() = default;
+        TSpectrum()
+                : r(0.f), g(0.f), b(0.f) {}
 
         // TODO Review this, might cause some problems
 //        explicit Spectrum(Float const &v)
 //                : r(v), g(v), b(v) {}
 
 
-        explicit Spectrum(float v)
+        explicit TSpectrum(float v)
                 : r(v), g(v), b(v) {}
 
-        Spectrum(Float const &r, Float const &g, Float const &b)
-                : r(r), g(g), b(b) {}
-
-        Spectrum(float r, float g, float b)
+        template<typename U>
+        TSpectrum(U const &r, U const &g, U const &b)
                 : r(r), g(g), b(b) {}
 
         // Math operators on itself
-        inline Spectrum &operator+=(Spectrum const &s) {
+        inline TSpectrum &operator+=(TSpectrum const &s) {
             r += s.r;
             g += s.g;
             b += s.b;
             return *this;
         }
 
-        inline Spectrum &operator-=(Spectrum const &s) {
+        inline TSpectrum &operator-=(TSpectrum const &s) {
             r -= s.r;
             g -= s.g;
             b -= s.b;
@@ -49,28 +49,28 @@ namespace drdemo {
         }
 
         // Spectrum sum
-        inline Spectrum operator+(Spectrum const &s) const {
-            return Spectrum(r + s.r, g + s.g, b + s.b);
+        inline TSpectrum operator+(TSpectrum const &s) const {
+            return TSpectrum(r + s.r, g + s.g, b + s.b);
         }
 
         // Spectrum difference
-        inline Spectrum operator-(Spectrum const &s) const {
-            return Spectrum(r - s.r, g - s.g, b - s.b);
+        inline TSpectrum operator-(TSpectrum const &s) const {
+            return TSpectrum(r - s.r, g - s.g, b - s.b);
         }
 
         // Spectrum scaling
-        inline Spectrum operator*(Spectrum const &s) const {
-            return Spectrum(r * s.r, g * s.g, b * s.b);
+        inline TSpectrum operator*(TSpectrum const &s) const {
+            return TSpectrum(r * s.r, g * s.g, b * s.b);
         }
 
         template<typename U>
-        inline Spectrum operator*(U const &t) const {
-            return Spectrum(t * r, t * g, t * b);
+        inline TSpectrum operator*(U const &t) const {
+            return TSpectrum(t * r, t * g, t * b);
         }
 
         template<typename U>
-        inline Spectrum operator/(U const &t) const {
-            return Spectrum(r / t, g / t, b / t);
+        inline TSpectrum operator/(U const &t) const {
+            return TSpectrum(r / t, g / t, b / t);
         }
 
         // Check if spectrum is black
@@ -79,22 +79,60 @@ namespace drdemo {
         }
     };
 
+    // Define common spectrum types
+    using Spectrum = TSpectrum<Float>;
+    using Spectrumf = TSpectrum<float>;
+
+    // Convert Float spectrum to float spectrum
+    inline Spectrumf Tofloat(Spectrum const &s) {
+        return Spectrumf(s.r.GetValue(), s.g.GetValue(), s.b.GetValue());
+    }
 
     // Abs of spectrum
     inline Spectrum Abs(Spectrum const &s) {
         return Spectrum(Abs(s.r), Abs(s.g), Abs(s.b));
     }
 
-    template<typename U>
-    inline Spectrum operator*(U const &t, Spectrum const &s) {
-        return Spectrum(t * s.r, t * s.g, t * s.b);
+    template<typename U, typename T>
+    inline TSpectrum<T> operator*(U const &t, TSpectrum<T> const &s) {
+        return TSpectrum<T>(t * s.r, t * s.g, t * s.b);
     }
 
     // Squared "Norm" of color
-    inline Float Norm(Spectrum const &s) {
+    template<typename T>
+    inline T Norm(TSpectrum<T> const &s) {
         return s.r * s.r + s.g * s.g + s.b * s.b;
     }
 
+    // Squared "Norm" of Float color, recorded as a single node
+    inline Float Norm(Spectrum const &s) {
+        const float partials[3] = {2.f * s.r.GetValue(), 2.f * s.g.GetValue(), 2.f * s.b.GetValue()};
+        Float const *const parents[3] = {&s.r, &s.g, &s.b};
+        return FusedNode(0.5f * (partials[0] * s.r.GetValue() + partials[1] * s.g.GetValue() +
+                                 partials[2] * s.b.GetValue()), 3, partials, parents);
+    }
+
+    // Compute scale * a * b / pdf
+    template<typename T>
+    inline TSpectrum<T> ScaledProduct(T const &scale, TSpectrum<T> const &a, TSpectrum<T> const &b, T const &pdf) {
+        return scale * a * b / pdf;
+    }
+
+    // Compute scale * a * b / pdf for Float colors, each channel is recorded as a single node
+    inline Spectrum ScaledProduct(Float const &scale, Spectrum const &a, Spectrum const &b, Float const &pdf) {
+        assert(pdf != 0.f);
+        const float inv_pdf = 1.f / pdf.GetValue();
+        auto channel = [&](Float const &a_c, Float const &b_c) {
+            const float s_f = scale.GetValue(), a_f = a_c.GetValue(), b_f = b_c.GetValue();
+            const float value = s_f * a_f * b_f * inv_pdf;
+            const float partials[4] = {a_f * b_f * inv_pdf, s_f * b_f * inv_pdf, s_f * a_f * inv_pdf,
+                                       -value * inv_pdf};
+            Float const *const parents[4] = {&scale, &a_c, &b_c, &pdf};
+            return FusedNode(value, 4, partials, parents);
+        };
+        return Spectrum(channel(a.r, b.r), channel(a.g, b.g), channel(a.b, b.b));
+    }
+
 } // drdemo namespace
 
 #endif //DRDEMO_SPECTRUM_HPP
@@ -33,6 +33,15 @@ namespace drdemo {
         return true;
     }
 
+    bool BoxFilterFilm::AddSample(Spectrumf const &s, size_t i, size_t j, float s_x, float s_y) {
+        // Check we are inside pixel boundaries
+        if (s_x < 0.f || s_x > 1.f || s_y < 0.f || s_y > 1.f) { return false; }
+        // Add sample
+        raster[j * width + i] = Spectrum(s.r, s.g, s.b);
+
+        return true;
+    }
+
     Spectrum const &BoxFilterFilm::At(size_t i, size_t j) const {
         // DEBUG ASSERTION
         // assert(num_samples[j * width + i] != 0.f);
@@ -85,6 +94,26 @@ namespace drdemo {
         return squared_norm;
     }
 
+    Float BoxFilterFilm::SquaredDifference(const std::vector<float> &raw_other,
+                                           size_t row_start, size_t row_end) const {
+        Float squared_difference;
+        for (size_t j = row_start; j < row_end; ++j) {
+            for (size_t i = 0; i < width; i++) {
+                size_t const index = j * width + i;
+                Spectrum const &s = At(i, j);
+                // Squared difference of the pixel recorded as a single node
+                const float partials[3] = {2.f * (s.r.GetValue() - raw_other[3 * index]),
+                                           2.f * (s.g.GetValue() - raw_other[3 * index + 1]),
+                                           2.f * (s.b.GetValue() - raw_other[3 * index + 2])};
+                Float const *const parents[3] = {&s.r, &s.g, &s.b};
+                squared_difference += FusedNode(0.25f * (partials[0] * partials[0] + partials[1] * partials[1] +
+                                                         partials[2] * partials[2]), 3, partials, parents);
+            }
+        }
+
+        return squared_difference;
+    }
+
     std::vector<float> BoxFilterFilm::Raw() const {
         std::vector<float> raw_data(width *height
         *3);
@@ -23,6 +23,8 @@ namespace drdemo {
 
         bool AddSample(Spectrum const &s, size_t i, size_t j, float s_x, float s_y) override;
 
+        bool AddSample(Spectrumf const &s, size_t i, size_t j, float s_x, float s_y) override;
+
         Spectrum const &At(size_t i, size_t j) const override;
 
         // Compute difference between this film and another one
@@ -33,6 +35,9 @@ namespace drdemo {
 
         Float SquaredNorm() const override;
 
+        // Compute the squared norm of the difference with other film's raw data, only over rows [row_start, row_end)
+        Float SquaredDifference(const std::vector<float> &raw_other, size_t row_start, size_t row_end) const;
+
         std::vector<float> Raw() const override;
 
         void Abs() override;
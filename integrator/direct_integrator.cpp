@@ -6,47 +6,44 @@
 
 namespace drdemo {
 
+    template<typename T>
+    TSpectrum<T> DirectIntegrator::Radiance(TRay<T> const &ray, Scene const &scene, Vector3<T> const &look_dir) const {
+        // Find closes interaction
+        TInteraction<T> interaction;
+        if (!scene.Intersect(ray, &interaction)) { return TSpectrum<T>(); }
+
+        return Shade(interaction, scene, look_dir);
+    }
+
+    template<typename T>
+    TSpectrum<T> DirectIntegrator::Shade(TInteraction<T> const &interaction, Scene const &scene,
+                                         Vector3<T> const &look_dir) const {
+        return Shade<T>(interaction, scene, look_dir,
+                        [](LightInterface const &light, TInteraction<T> const &i, Vector3<T> *wi, T *pdf) {
+                            return light.SampleLi(i, 0.f, 0.f, wi, pdf);
+                        });
+    }
+
     Spectrum DirectIntegrator::IncomingRadiance(Ray const &ray, Scene const &scene, const CameraInterface &camera,
                                                 size_t depth) const {
-        // Final ray incoming radiance
-        Spectrum L;
+        return Radiance(ray, scene, camera.LookDir());
+    }
 
-        // Find closes interaction
-        Interaction interaction;
-        if (!scene.Intersect(ray, &interaction)) { return L; }
-
-        // TODO Testing if we get better result when lights comes from the camera
-        if (scene.GetLights().empty()) {
-            // No lights, only take albedo into account
-            const Float n_dot_l = Clamp(Dot(interaction.n, -camera.LookDir()), Float(0.f), Float(1.f));
-            L = n_dot_l * interaction.albedo;
-        } else {
-            for (const auto &light : scene.GetLights()) {
-                for (int s = 0; s < light->NumSamples(); ++s) {
-                    Vector3F wi;
-                    Float pdf;
-                    const Spectrum Li = light->SampleLi(interaction, 0.f, 0.f, &wi, &pdf);
-                    const Float n_dot_l = Dot(interaction.n, wi);
-                    if (!Li.IsBlack() && pdf != 0.f && n_dot_l > 0.f) {
-                        L += n_dot_l * interaction.albedo * Li / pdf;
-                    }
-                }
-                // Scale given the number of samples
-                L = L / (float) light->NumSamples();
-            }
-        }
+    Spectrumf DirectIntegrator::IncomingRadiance(Rayf const &ray, Scene const &scene, const CameraInterface &camera,
+                                                 size_t) const {
+        return Radiance(ray, scene, Tofloat(camera.LookDir()));
+    }
 
-        // Compute shading at hit point
-        // for (auto const &light : scene.GetLights()) {
-        //     if (light->IsEnabled()) {
-        // Vector3F wi;
-        // Float pdf;
-        // const Spectrum Li = light->SampleLi(interaction, 0.f, 0.f, &wi, &pdf);
-        // L += Li * Abs(Dot(interaction.n, wi)) / pdf;
-        //     }
-        // }
-
-        return L;
+    void DirectIntegrator::IncomingRadiancePacket(RayPacketf const &packet, Scene const &scene,
+                                                  const CameraInterface &camera, size_t, Spectrumf *L) const {
+        // Intersect the rays together, then shade each hit
+        Interactionf interactions[RAY_PACKET_SIZE];
+        bool hits[RAY_PACKET_SIZE];
+        scene.IntersectPacket(packet, interactions, hits);
+        const Vector3f look_dir = Tofloat(camera.LookDir());
+        for (int lane = 0; lane < packet.size; lane++) {
+            L[lane] = hits[lane] ? Shade(interactions[lane], scene, look_dir) : Spectrumf();
+        }
     }
 
 } // drdemo namespace
\ No newline at end of file
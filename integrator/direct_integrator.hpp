@@ -13,13 +13,78 @@ namespace drdemo {
      * Define DirectIntegrator class, which is a simple integrator that computes direct illumination the scene
      */
     class DirectIntegrator : public SurfaceIntegratorInterace {
+    private:
+        // Compute the incoming radiance on the Float or on the passive render path
+        template<typename T>
+        TSpectrum<T> Radiance(TRay<T> const &ray, Scene const &scene, Vector3<T> const &look_dir) const;
+
+        // Light reflected towards the camera at an interaction, shared by the single ray and the packet paths
+        template<typename T>
+        TSpectrum<T> Shade(TInteraction<T> const &interaction, Scene const &scene, Vector3<T> const &look_dir) const;
+
     public:
         DirectIntegrator() = default;
 
         Spectrum IncomingRadiance(Ray const &ray, Scene const &scene, const CameraInterface &camera,
                                   size_t depth) const override;
+
+        Spectrumf IncomingRadiance(Rayf const &ray, Scene const &scene, const CameraInterface &camera,
+                                   size_t depth) const override;
+
+        void IncomingRadiancePacket(RayPacketf const &packet, Scene const &scene, const CameraInterface &camera,
+                                    size_t depth, Spectrumf *L) const override;
+
+        /**
+         * Light reflected towards the camera at an interaction, sample_li(light, interaction, &wi, &pdf) gives the
+         * radiance of each light of the scene. Its scalar S may differ from the one of the geometry, like a Dual<N>
+         * radiance that carries the derivatives with respect to the light parameters through a passive render
+         */
+        template<typename S, typename T, typename SampleLi>
+        static TSpectrum<S> Shade(TInteraction<T> const &interaction, Scene const &scene, Vector3<T> const &look_dir,
+                                  SampleLi const &sample_li);
     };
 
+    template<typename S, typename T, typename SampleLi>
+    TSpectrum<S> DirectIntegrator::Shade(TInteraction<T> const &interaction, Scene const &scene,
+                                         Vector3<T> const &look_dir, SampleLi const &sample_li) {
+        // Final ray incoming radiance
+        TSpectrum<S> L;
+        const TSpectrum<S> albedo(interaction.albedo.r, interaction.albedo.g, interaction.albedo.b);
+
+        // TODO Testing if we get better result when lights comes from the camera
+        if (scene.GetLights().empty()) {
+            // No lights, only take albedo into account
+            const T n_dot_l = Clamp(Dot(interaction.n, -look_dir), T(0.f), T(1.f));
+            L = S(n_dot_l) * albedo;
+        } else {
+            for (const auto &light : scene.GetLights()) {
+                for (int s = 0; s < light->NumSamples(); ++s) {
+                    Vector3<T> wi;
+                    T pdf;
+                    const TSpectrum<S> Li = sample_li(*light, interaction, &wi, &pdf);
+                    const T n_dot_l = Dot(interaction.n, wi);
+                    if (!Li.IsBlack() && pdf != 0.f && n_dot_l > 0.f) {
+                        L += ScaledProduct(S(n_dot_l), albedo, Li, S(pdf));
+                    }
+                }
+                // Scale given the number of samples
+                L = L / (float) light->NumSamples();
+            }
+        }
+
+        // Compute shading at hit point
+        // for (auto const &light : scene.GetLights()) {
+        //     if (light->IsEnabled()) {
+        // Vector3F wi;
+        // Float pdf;
+        // const Spectrum Li = light->SampleLi(interaction, 0.f, 0.f, &wi, &pdf);
+        // L += Li * Abs(Dot(interaction.n, wi)) / pdf;
+        //     }
+        // }
+
+        return L;
+    }
+
 } // drdemo namespace
 
 #endif //DRDEMO_DIRECT_INTEGRATOR_HPP
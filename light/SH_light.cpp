@@ -77,6 +77,8 @@ namespace drdemo {
               samples(num_samples),
               num_bands(num_bands), num_coeff(num_bands * num_bands), coefficients(new Float[num_coeff]),
               used_samples(0) {
+        // The coefficients are the differentiable variables of the light
+        Float::RegisterVariables(coefficients.get(), static_cast<size_t>(num_coeff));
         // Array index
         int i = 0;
         // Random number generator
@@ -137,8 +139,8 @@ namespace drdemo {
 
         // New method, only return one sample
         *pdf = 1.f; // (4.f * PI);
-        // Get current sample
-        const auto &sample = samples[used_samples];
+        // Get current sample and increase number of used samples
+        const auto &sample = samples[used_samples.fetch_add(1) % static_cast<unsigned>(num_samples)];
         // Set light direction
         wi->x = sample.dir.x;
         wi->y = sample.dir.y;
@@ -148,8 +150,21 @@ namespace drdemo {
         for (int i = 1; i < num_coeff; ++i) {
             sh_value += coefficients[i] * sample.coeff[i];
         }
-        // Increase number of used samples
-        used_samples = (used_samples == num_samples - 1) ? 0 : (used_samples + 1);
+
+        return {sh_value, sh_value, sh_value};
+    }
+
+    Spectrumf SHLight::SampleLi(const Interactionf &, float, float, Vector3f *wi, float *pdf) const {
+        *pdf = 1.f;
+        // Get current sample and increase number of used samples
+        const auto &sample = samples[used_samples.fetch_add(1) % static_cast<unsigned>(num_samples)];
+        // Set light direction
+        *wi = sample.dir;
+        // Compute SH value
+        float sh_value = 0.f;
+        for (int i = 0; i < num_coeff; ++i) {
+            sh_value += coefficients[i].GetValue() * sample.coeff[i];
+        }
 
         return {sh_value, sh_value, sh_value};
     }
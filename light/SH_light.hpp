@@ -6,6 +6,7 @@
 #define DRDEMO_SH_LIGHT_HPP
 
 #include <functional>
+#include <atomic>
 #include <bits/unique_ptr.h>
 #include "light.hpp"
 
@@ -41,8 +42,8 @@ namespace drdemo {
         int num_coeff;
         // Computed coefficients
         std::unique_ptr<Float[]> coefficients;
-        // Used number of sample
-        mutable int used_samples;
+        // Used number of sample, atomic since the image rows can be rendered in parallel
+        mutable std::atomic<unsigned> used_samples;
 
         // Evaluate P function
         float P(int l, int m, float x) const;
@@ -59,6 +60,9 @@ namespace drdemo {
         Spectrum SampleLi(const Interaction &interaction, float u0, float u1,
                           Vector3F *wi, Float *pdf) const override;
 
+        Spectrumf SampleLi(const Interactionf &interaction, float u0, float u1,
+                           Vector3f *wi, float *pdf) const override;
+
         // Initialise the SH given a function
         void Initialise(const SphericalFunction &func);
     };
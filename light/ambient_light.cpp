@@ -6,7 +6,10 @@
 
 namespace drdemo {
 
-    AmbientLight::AmbientLight(const Spectrum &i) : intensity(i) {}
+    AmbientLight::AmbientLight(const Spectrum &i)
+    // The intensity channels are the differentiable variables of the light
+            : intensity(Float::Variable(i.r.GetValue()), Float::Variable(i.g.GetValue()),
+                        Float::Variable(i.b.GetValue())) {}
 
     Spectrum
     AmbientLight::SampleLi(Interaction const &interaction, float u0, float u1, Vector3F *wi, Float *pdf) const {
@@ -21,6 +24,17 @@ namespace drdemo {
         return intensity;
     }
 
+    Spectrumf
+    AmbientLight::SampleLi(Interactionf const &interaction, float, float, Vector3f *wi, float *pdf) const {
+        // Set as interaction normal
+        *wi = interaction.n;
+
+        // Set pdf
+        *pdf = 1.f;
+
+        return Tofloat(intensity);
+    }
+
     void AmbientLight::GetDiffVariables(std::vector<Float const *> &vars) const {
         // Add RGB values as differentiable variables
         vars.push_back(&(intensity.r));
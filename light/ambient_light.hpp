@@ -7,6 +7,7 @@
 
 #include "light.hpp"
 #include "diff_object.hpp"
+#include "dual.hpp"
 
 namespace drdemo {
 
@@ -25,6 +26,19 @@ namespace drdemo {
         Spectrum SampleLi(const Interaction &interaction, float u0, float u1,
                           Vector3F *wi, Float *pdf) const override;
 
+        Spectrumf SampleLi(const Interactionf &interaction, float u0, float u1,
+                           Vector3f *wi, float *pdf) const override;
+
+        // Forward mode version of the passive SampleLi, the intensity channels are returned as the Dual<N> variables
+        // of the tangent directions first, first + 1 and first + 2
+        template<size_t N>
+        TSpectrum<Dual<N> > SampleLiDual(const Interactionf &interaction, size_t first, Vector3f *wi,
+                                         float *pdf) const {
+            const Spectrumf i = SampleLi(interaction, 0.f, 0.f, wi, pdf);
+            return TSpectrum<Dual<N> >(Dual<N>::Variable(i.r, first), Dual<N>::Variable(i.g, first + 1),
+                                       Dual<N>::Variable(i.b, first + 2));
+        }
+
         void GetDiffVariables(std::vector<Float const *> &vars) const override;
 
         size_t GetNumVars() const noexcept override;
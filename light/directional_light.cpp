@@ -18,4 +18,13 @@ namespace drdemo {
         return intensity;
     }
 
+    Spectrumf
+    DirectionalLight::SampleLi(Interactionf const &interaction, float u0, float u1,
+                               Vector3f *const wi, float *pdf) const {
+        *wi = Tofloat(direction);
+        *pdf = 1.f;
+
+        return Tofloat(intensity);
+    }
+
 } // drdemo namespace
@@ -18,4 +18,14 @@ namespace drdemo {
         return (intensity / LengthSquared(position - interaction.p));
     }
 
+    Spectrumf
+    PointLight::SampleLi(Interactionf const &interaction, float u0, float u1,
+                         Vector3f *const wi, float *pdf) const {
+        const Vector3f position_f = Tofloat(position);
+        *wi = Normalize(position_f - interaction.p);
+        *pdf = 1.f;
+
+        return (Tofloat(intensity) / LengthSquared(position_f - interaction.p));
+    }
+
 } // drdemo namespace
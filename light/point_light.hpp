@@ -24,6 +24,9 @@ namespace drdemo {
 
         Spectrum SampleLi(Interaction const &interaction, float u0, float u1,
                           Vector3F *wi, Float *pdf) const override;
+
+        Spectrumf SampleLi(Interactionf const &interaction, float u0, float u1,
+                           Vector3f *wi, float *pdf) const override;
     };
 
 } // drdemo namespace
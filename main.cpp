@@ -4,7 +4,12 @@
 
 #include <scene.hpp>
 #include <dino_test.hpp>
+#include <sweep_benchmark.hpp>
+#include <layout_benchmark.hpp>
+#include <intersector_benchmark.hpp>
+#include <dual_light_test.hpp>
 #include <sdf_sphere.hpp>
+#include <sdf_file.hpp>
 #include <bunny_test.hpp>
 #include <SH_light.hpp>
 #include <torus_test.hpp>
@@ -122,6 +127,7 @@ int main() {
 
     // Test SDF loading + rendering
     // LoadAndTestSDF("../sdfs/dragon_mvs_output.sdf", 512, 512);
+    // LoadAndTestSparseSDF("../sdfs/dragon_mvs_output.sdf", 3, 512, 512);
 
     // Full pipeline test
     // FullPipelineTestDragon(4, 1.1f);            // Final output test for thesis
@@ -141,6 +147,31 @@ int main() {
     // DinoTest(1.1f, 3);   // With "../sdfs/dino_watertight.sdf"
     // DinoTest(1.2f, 4);      // With "../sdfs/dino_watertight_low.sdf"
 
+    /**
+     * Convert a text SDF to the binary format, the grids load either one
+     */
+    // ConvertSDFToBinary("../sdfs/dino_watertight_low.sdf", "../sdfs/dino_watertight_low.sdfb");
+
+    /**
+     * Compare the reverse sweeps on the tape of a dino view
+     */
+    // SweepBenchmark(10);
+
+    /**
+     * Compare the rays per second of the grid layouts
+     */
+    // GridLayoutBenchmark(256, 4);
+
+    /**
+     * Compare sphere tracing and the DDA intersector of the grid
+     */
+    // GridIntersectorBenchmark(256, 4);
+
+    /**
+     * Compare the forward Dual derivatives of the ambient light intensity with the ones of the tape
+     */
+    // DualAmbientLightTest(0.8f, 0.9f, 1.f);
+
     /**
      * Test bunny rendering using SH and smooth start
      */
@@ -473,7 +504,7 @@ int main() {
 //                // Compute point coordinates
 //                Vector3f p(-2.f + delta * x, -2.f + delta * y, -2.f + delta * z);
 //                // Use ellipse equation
-//                grid->operator()(x, y, z) = Length(p) - 1.f;
+//                grid->SetValue(x, y, z, Length(p) - 1.f);
 //            }
 //        }
 //    }
@@ -614,7 +645,7 @@ int main() {
 //            for (int z = 0; z < grid_dims[2]; z++) {
 //                // Compute point coordinates
 //                Vector3f p(-2.f + delta_s * x, -2.f + delta_s * y, -2.f + delta_s * z);
-//                grid->operator()(x, y, z) = Length(p) - 1.f;
+//                grid->SetValue(x, y, z, Length(p) - 1.f);
 //            }
 //        }
 //    }
@@ -3,6 +3,7 @@
 //
 
 #include "gradient_descent.hpp"
+#include "tape_profiler.hpp"
 
 namespace drdemo {
 
@@ -23,6 +24,8 @@ namespace drdemo {
 
         // Minimize function
         do {
+            // Attribute the tape usage of the iteration to its own profiler scope
+            TapeProfileScope profile_scope("iteration");
             // Push current status of the automatic differentiation tape
             default_tape.Push();
 
@@ -61,6 +64,9 @@ namespace drdemo {
             // Increase number of iterations
             iters++;
         } while (grad_norm > grad_tol && iters < max_iters);
+
+        // Print tape usage if it was profiled
+        if (verbose && TapeProfiler::IsEnabled()) { TapeProfiler::PrintTable(std::cout); }
     }
 
     static std::vector<float>
@@ -102,6 +108,7 @@ namespace drdemo {
         f.SetStatus(test_status);
 
         // Disable tape registering since we don't need the derivatives
+        TapeProfileScope profile_scope("line search");
         default_tape.Disable();
 
         // Value of the function at current test status
@@ -163,6 +170,8 @@ namespace drdemo {
 
         // Minimize function
         do {
+            // Attribute the tape usage of the iteration to its own profiler scope
+            TapeProfileScope profile_scope("iteration");
             // Push current status of the automatic differentiation tape
             default_tape.Push();
 
@@ -205,6 +214,9 @@ namespace drdemo {
             // Increase number of iterations
             iters++;
         } while (grad_norm > grad_tol && alpha > step_tol && iters < max_iters);
+
+        // Print tape usage if it was profiled
+        if (verbose && TapeProfiler::IsEnabled()) { TapeProfiler::PrintTable(std::cout); }
     }
 
 } // drdemo namespace
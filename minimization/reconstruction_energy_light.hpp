@@ -42,6 +42,8 @@ namespace drdemo {
 
         // Vector of pointers to all the differentiable variables
         std::vector<Float const *> diff_variables;
+        // Tape indices of the differentiable variables, same order
+        std::vector<size_t> diff_indices;
         // Class to compute derivatives
         mutable Derivatives derivatives;
         // The gradient is now computed progressively during the computation of the single terms of the energy
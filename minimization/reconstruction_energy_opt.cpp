@@ -4,6 +4,7 @@
 
 #include "reconstruction_energy_opt.hpp"
 #include "box_film.hpp"
+#include "tape_profiler.hpp"
 
 namespace drdemo {
 
@@ -23,6 +24,8 @@ namespace drdemo {
 
         // Get pointer to all the differentiable variables of the grid
         this->grid->GetDiffVariables(diff_variables);
+        // Store their tape indices
+        for (auto var : diff_variables) { diff_indices.push_back(var->NodeIndex()); }
     }
 
     void ReconstructionEnergyOpt::RebindVars() {
@@ -30,6 +33,8 @@ namespace drdemo {
         diff_variables.clear();
         // Rebind
         grid->GetDiffVariables(diff_variables);
+        diff_indices.clear();
+        for (auto var : diff_variables) { diff_indices.push_back(var->NodeIndex()); }
         // Change gradient size according to new number of variables
         gradient.resize(diff_variables.size());
     }
@@ -46,106 +51,58 @@ namespace drdemo {
      */
     Float ReconstructionEnergyOpt::Evaluate(bool output) const {
         // First energy term that contains the sum of the difference between the rendered images and the targets
-        Float E_images;
-        // Image energy term computed currently
-        Float E_image_t;
-
-        // bool gradient_to_zero = false;
-        // Clear derivatives
-        derivatives.Clear();
+        float E_images = 0.f;
 
         // Film to render the image on
         BoxFilterFilm render(width, height);
-        BoxFilterFilm difference(width, height);
 
-        // Current evaluated energy term gradient
-        // std::vector<float> image_term_grad(gradient.size(), 0.f);
+        // Check if we need to compute the gradient
+        if (default_tape.IsEnabled()) {
+            // Reset gradient
+            for (auto &v : gradient) { v = 0.f; }
+        }
 
         // Loop over all target target_cameras
         for (size_t target_index = 0; target_index < target_cameras.size(); ++target_index) {
+            // Attribute the tape usage of the view to its own profiler scope
+            TapeProfileScope profile_scope("view " + std::to_string(target_index));
             // Push where we are before rendering current image
             default_tape.Push();
 
-            // Render scene for current camera
-            renderer->RenderImage(&render, target_scene, *target_cameras[target_index]);
+            const CameraInterface &camera = *target_cameras[target_index];
+            const std::vector<float> &target_view = target_views[target_index];
+            // Render scene for current camera and compute single image energy, the rows are split between the threads
+            // The gradient of the term is added to the current one
+            const float E_image_t = derivatives.ParallelSum(0, height, [&](size_t row_start, size_t row_end) {
+                renderer->RenderRows(&render, target_scene, camera, row_start, row_end);
+                // Compute difference between rendering and target
+                return render.SquaredDifference(target_view, row_start, row_end);
+            }, diff_indices.data(), diff_indices.size(), gradient.data());
 
             // If we are at view zero and output is true, output image
             if (output && target_index == 0) {
                 tonemapper.Process("iterations_" + std::to_string(evaluations) + ".png", render);
             }
 
-            // Compute difference between rendering and target
-            difference = render - target_views[target_index];
-            // Compute single image energy
-            E_image_t = difference.SquaredNorm();
-
-            // Check if we need to compute the gradient
-            if (default_tape.IsEnabled()) {
-                // Compute gradient
-                if (target_index == 0) {
-                    // Reset gradient
-                    for (auto &v : gradient) { v = 0.f; }
-                }
-                // Compute derivatives for current image term
-                derivatives.Clear();
-                derivatives.ComputeDerivatives(E_image_t);
-                // Compute gradient for current term
-                for (size_t i = 0; i < gradient.size(); ++i) {
-                    gradient[i] += derivatives.Dwrt(E_image_t, *diff_variables[i]);
-                }
-                // Add contribution to final gradient
-//                for (size_t i = 0; i < gradient.size(); ++i) {
-//                    gradient[i] += image_term_grad[i];
-//                }
-            }
-
             // Sum current rendering difference to total energy
-            E_images += E_image_t;      // FIXME We can not use this value anymore to compute derivateives!!!
+            E_images += E_image_t;
             default_tape.Pop();
         }
 
-        // Second energy term that contains the sum of the squared norms of the normals minus 1 (each one)
-        Float E_normals;
-
-        default_tape.Push();
-        // Loop over all internal points of the grid, compute the normal and sum up
-        for (int z = 0; z < grid->Size(2); z++) {
-            for (int y = 0; y < grid->Size(1); y++) {
-                for (int x = 0; x < grid->Size(0); x++) {
-                    // Get normal
-                    const Vector3F n = grid->NormalAtPoint(x, y, z);
-                    // Add to energy
-                    E_normals += Pow(LengthSquared(n) - 1.f, 2.f);
-                }
-            }
-        }
-        if (default_tape.IsEnabled()) {
-            // Add final contribution of normal term to gradient
-            derivatives.Clear();
-            derivatives.ComputeDerivatives(E_normals);
-            // Compute gradient for current term
-//            for (size_t i = 0; i < gradient.size(); ++i) {
-//                image_term_grad[i] = derivatives.Dwrt(E_normals, *diff_variables[i]);
-//            }
-            // Add contribution to final gradient
-            for (size_t i = 0; i < gradient.size(); ++i) {
-                // Lambda * gradient !!!
-                gradient[i] += lambda * derivatives.Dwrt(E_normals, *diff_variables[i]);
-            }
-        }
-        // We have our gradient, clear derivatives
-        // derivatives.Clear();
-        // Pop tape
-        default_tape.Pop();
+        // Second energy term that contains the sum of the squared norms of the normals minus 1 (each one). It is a
+        // fixed stencil over the grid values, so the grid computes it and its gradient without the tape,
+        // lambda * gradient is added to the current one
+        float *const normals_gradient = default_tape.IsEnabled() ? gradient.data() : nullptr;
+        const float E_normals = grid->NormalRegularization(normals_gradient, lambda);
 
         // Increase number of evaluations if we used the ouput
         if (output) { evaluations++; }
         // Store last computed values for the terms
-        image_term = E_images.GetValue();
-        normal_term = E_normals.GetValue();
+        image_term = E_images;
+        normal_term = E_normals;
 
         // Return final energy = E_images + lambda * E_normals
-        return E_images + lambda * E_normals;
+        return Float(E_images + lambda * E_normals);
     }
 
     std::vector<float> ReconstructionEnergyOpt::ComputeGradient(const Float &) const {
@@ -3,42 +3,51 @@
 //
 
 #include <iostream>
+#include <algorithm>
+#include <parallel.hpp>
 #include "derivative.hpp"
+#include "tape_profiler.hpp"
 
 namespace drdemo {
 
+    // Stop the program when the derivatives involve nodes that were not registered
+    static void ExitUnregistered() {
+        std::cerr << "Warning! Trying to compute derivative that involves unregistered nodes!" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
     void Derivatives::Clear() {
         var_derivatives_map.clear();
     }
 
+    // Lowest of the given tape indices, no derivative flows below it. Returns limit if all are larger
+    static size_t LowestIndex(size_t const *const indices, size_t num_indices, size_t limit) {
+        size_t lowest = limit;
+        for (size_t i = 0; i < num_indices; ++i) { lowest = std::min(lowest, indices[i]); }
+        return lowest;
+    }
+
     void Derivatives::ComputeDerivatives(Float const &var) {
-        size_t const size = default_tape.Size();
         // Check if element is already in the map
         if (var_derivatives_map.find(var) != var_derivatives_map.end()) {
             std::cout << "Variable derivatives already computed, exiting..." << std::endl;
             return;
         }
+        // The output must be recorded on the tape
+        if (var.NodeIndex() == NOT_REGISTERED) { ExitUnregistered(); }
+        // Only the nodes between the lowest registered parameter and the output need an adjoint
+        const size_t begin = std::min(CurrentTape().LowestParameter(), var.NodeIndex());
+        const size_t end = var.NodeIndex() + 1;
         // Create new entry
-        var_derivatives_map[var] = std::vector<float>(size, 0.f);
-        // Get reference to make code more clear
-        std::vector<float> &derivs = var_derivatives_map[var];
+        AdjointsWindow &derivs = var_derivatives_map[var];
+        derivs.begin = begin;
+        derivs.adjoints.assign(end - begin, 0.f);
 
         // Seed at index of the input variable
-        derivs[var.NodeIndex()] = 1.f;
+        derivs.adjoints[var.NodeIndex() - begin] = 1.f;
 
         // Traverse the tape in reverse
-        for (size_t i = 0; i < size; i++) {
-            size_t const rev_index = size - 1 - i;
-            TapeNode const &node = default_tape.At(rev_index);
-
-            // Add children contribution
-            if (node.parent_i[0] == NOT_REGISTERED || node.parent_i[1] == NOT_REGISTERED) {
-                std::cerr << "Warning! Trying to compute derivative that involves unregistered nodes!" << std::endl;
-                exit(EXIT_FAILURE);
-            }
-            derivs[node.parent_i[0]] += node.weights[0] * derivs[rev_index];
-            derivs[node.parent_i[1]] += node.weights[1] * derivs[rev_index];
-        }
+        Backpropagate(CurrentTape(), begin, end, derivs.adjoints.data());
     }
 
     float Derivatives::Dwrt(Float const &f, Float const &x) const {
@@ -48,7 +57,179 @@ namespace drdemo {
             std::cout << "Could not find given output variable!" << std::endl;
             return 0.f;
         }
-        return it->second[x.NodeIndex()];
+        // Constants and nodes outside of the swept window have zero derivative
+        AdjointsWindow const &derivs = it->second;
+        if (x.NodeIndex() < derivs.begin || x.NodeIndex() - derivs.begin >= derivs.adjoints.size()) { return 0.f; }
+        return derivs.adjoints[x.NodeIndex() - derivs.begin];
+    }
+
+    Derivatives::StreamPositions Derivatives::PositionsAt(Tape const &tape, size_t end) {
+        // The nodes below the base index are not on this tape
+        assert(end >= tape.BaseIndex());
+        StreamPositions positions = {tape.NumUnary(), tape.NumBinary(), tape.NumNary(), tape.NumNaryEntries()};
+        // Skip the nodes recorded after end
+        for (size_t index = tape.Size(); index-- > end;) {
+            const NodeKind kind = tape.Kind(index);
+            if (kind == NodeKind::UNARY) { positions.unary--; }
+            else if (kind == NodeKind::BINARY) { positions.binary--; }
+            else if (kind == NodeKind::NARY) { positions.nary_entries -= tape.NaryCount(--positions.nary); }
+        }
+        return positions;
+    }
+
+    void Derivatives::Backpropagate(Tape const &tape, size_t end, std::vector<float> &adjoints) {
+        assert(adjoints.size() >= end);
+        Backpropagate(tape, 0, end, adjoints.data());
+    }
+
+    void Derivatives::Backpropagate(Tape const &tape, size_t begin, size_t end, float *const adjoints) {
+        assert(begin <= end && end <= tape.Size());
+        // Position in the unary, binary and n-ary streams, skip the nodes recorded after end
+        const StreamPositions positions = PositionsAt(tape, end);
+        size_t unary_i = positions.unary;
+        size_t binary_i = positions.binary;
+        size_t nary_i = positions.nary;
+        size_t entry_i = positions.nary_entries;
+        // Size of the adjoints window, the parents below it are not needed
+        const size_t window = end - begin;
+
+        // Traverse the tape in reverse, stop at the start of the window or of the tape
+        for (size_t rev_index = end; rev_index-- > std::max(begin, tape.BaseIndex());) {
+            switch (tape.Kind(rev_index)) {
+                case NodeKind::UNARY: {
+                    UnaryNode const &node = tape.Unary(--unary_i);
+                    assert(node.parent_i != NOT_REGISTERED_PARENT);
+                    // Add children contribution
+                    const size_t parent = node.parent_i - begin;
+                    if (parent < window) { adjoints[parent] += node.weight * adjoints[rev_index - begin]; }
+                    break;
+                }
+                case NodeKind::BINARY: {
+                    BinaryNode const &node = tape.Binary(--binary_i);
+                    assert(node.parent_i[0] != NOT_REGISTERED_PARENT && node.parent_i[1] != NOT_REGISTERED_PARENT);
+                    // Add children contribution
+                    const float adjoint = adjoints[rev_index - begin];
+                    const size_t parent_0 = node.parent_i[0] - begin;
+                    const size_t parent_1 = node.parent_i[1] - begin;
+                    if (parent_0 < window) { adjoints[parent_0] += node.weights[0] * adjoint; }
+                    if (parent_1 < window) { adjoints[parent_1] += node.weights[1] * adjoint; }
+                    break;
+                }
+                case NodeKind::NARY: {
+                    const size_t count = tape.NaryCount(--nary_i);
+                    entry_i -= count;
+                    const float adjoint = adjoints[rev_index - begin];
+                    for (size_t e = entry_i; e < entry_i + count; ++e) {
+                        UnaryNode const &entry = tape.NaryEntry(e);
+                        assert(entry.parent_i != NOT_REGISTERED_PARENT);
+                        const size_t parent = entry.parent_i - begin;
+                        if (parent < window) { adjoints[parent] += entry.weight * adjoint; }
+                    }
+                    break;
+                }
+                case NodeKind::LEAF:
+                    // Leaf nodes have no parents
+                    break;
+            }
+        }
+    }
+
+    void Derivatives::GatherAdjoints(size_t const *const indices, size_t num_indices, float *const gradient,
+                                     float scale) const {
+        for (size_t i = 0; i < num_indices; ++i) {
+            // Nodes recorded after the output have no adjoint
+            const size_t local = indices[i] - adjoints_begin;
+            if (indices[i] >= adjoints_begin && local < adjoints.size()) {
+                gradient[i] += scale * adjoints[local];
+            }
+        }
+    }
+
+    void Derivatives::Gather(Float const &f, size_t const *const indices, size_t num_indices, float *const gradient,
+                             float scale) {
+        if (f.NodeIndex() == NOT_REGISTERED) { return; }
+        // Nodes after the output do not contribute and no derivative flows below the lowest index, only sweep
+        // the window between them
+        const size_t end = f.NodeIndex() + 1;
+        adjoints_begin = LowestIndex(indices, num_indices, f.NodeIndex());
+        adjoints.assign(end - adjoints_begin, 0.f);
+        adjoints[f.NodeIndex() - adjoints_begin] = 1.f;
+        Backpropagate(CurrentTape(), adjoints_begin, end, adjoints.data());
+        GatherAdjoints(indices, num_indices, gradient, scale);
+    }
+
+    float Derivatives::ParallelSum(size_t begin, size_t end, std::function<Float(size_t, size_t)> const &term,
+                                   size_t const *const indices, size_t num_indices, float *const gradient,
+                                   float scale) {
+        Tape &parent = CurrentTape();
+        // Nodes recorded before the fork, the only ones the threads can share
+        const size_t fork_index = parent.Size();
+        const bool compute_adjoints = parent.IsEnabled();
+        // No derivative flows below the lowest requested index, the adjoints are only stored from there
+        const size_t window_begin = LowestIndex(indices, num_indices, fork_index);
+        // The nodes recorded by the threads are attributed to the profiler scope of the calling one
+        const std::string caller_scope = TapeProfiler::CurrentScope();
+
+        const size_t num_threads = NumThreads();
+        std::vector<float> partial_sums(num_threads, 0.f);
+        thread_adjoints.resize(num_threads);
+        thread_tapes.resize(num_threads);
+        // One byte per thread, the bits of a std::vector<bool> share words and the threads would race writing them
+        std::vector<char> thread_recorded(num_threads, 0);
+        // Output of the threads whose term is a node recorded before the fork, it is seeded on the calling tape
+        std::vector<size_t> thread_seeds(num_threads, NOT_REGISTERED);
+
+        ParallelFor(begin, end, [&](size_t thread_index, size_t chunk_begin, size_t chunk_end) {
+            // Record the term on a private tape, reusing the memory of the previous calls
+            Tape &tape = thread_tapes[thread_index];
+            tape.Rebase(parent);
+            TapeScope scope(tape);
+            const Float partial = [&]() {
+                TapeProfileScope profile_scope(caller_scope, false);
+                return term(chunk_begin, chunk_end);
+            }();
+            partial_sums[thread_index] = partial.GetValue();
+
+            if (compute_adjoints && partial.NodeIndex() < fork_index) {
+                // Nothing of the term is on the private tape, e.g. a parameter returned as it is
+                thread_seeds[thread_index] = partial.NodeIndex();
+            } else if (compute_adjoints && partial.NodeIndex() != NOT_REGISTERED) {
+                // Sweep the private tape, the nodes below the fork index receive the adjoints for the parent tape
+                std::vector<float> &local_adjoints = thread_adjoints[thread_index];
+                local_adjoints.assign(partial.NodeIndex() + 1 - window_begin, 0.f);
+                local_adjoints[partial.NodeIndex() - window_begin] = 1.f;
+                Backpropagate(tape, window_begin, partial.NodeIndex() + 1, local_adjoints.data());
+                thread_recorded[thread_index] = 1;
+            }
+        }, num_threads);
+
+        if (compute_adjoints) {
+            // Merge the adjoints of all threads
+            adjoints_begin = window_begin;
+            adjoints.assign(fork_index - window_begin, 0.f);
+            ParallelFor(0, adjoints.size(), [&](size_t, size_t chunk_begin, size_t chunk_end) {
+                for (size_t t = 0; t < num_threads; ++t) {
+                    if (!thread_recorded[t]) { continue; }
+                    const std::vector<float> &local_adjoints = thread_adjoints[t];
+                    const size_t local_end = std::min(chunk_end, local_adjoints.size());
+                    for (size_t i = chunk_begin; i < local_end; ++i) {
+                        adjoints[i] += local_adjoints[i];
+                    }
+                }
+            }, num_threads);
+            for (size_t seed : thread_seeds) {
+                if (seed >= window_begin && seed < fork_index) { adjoints[seed - window_begin] += 1.f; }
+            }
+            // Propagate them through the nodes recorded on the calling tape
+            Backpropagate(parent, window_begin, fork_index, adjoints.data());
+            GatherAdjoints(indices, num_indices, gradient, scale);
+        }
+
+        // Sum partial results
+        float sum = 0.f;
+        for (float partial_sum : partial_sums) { sum += partial_sum; }
+
+        return sum;
     }
 
 } // drdemo namespace
\ No newline at end of file
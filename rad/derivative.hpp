@@ -6,6 +6,7 @@
 #define DRDEMO_DERIVATIVE_HPP
 
 #include <map>
+#include <functional>
 #include "rad.hpp"
 
 namespace drdemo {
@@ -13,11 +14,38 @@ namespace drdemo {
     /**
      * The Derivatives class is used in conjunction with a variable to compute the derivative of a variable with respect
      * to another one
+     *
+     * The Gather and ParallelSum methods write the derivatives with respect to a list of tape indices straight into a
+     * caller owned gradient buffer, the adjoint buffers are kept by the object and reused between calls
      */
     class Derivatives {
     private:
+        // Adjoints of the nodes with index from begin on
+        struct AdjointsWindow {
+            size_t begin;
+            std::vector<float> adjoints;
+        };
+
         // Associate variables with derivatives
-        std::map<Float, std::vector<float> > var_derivatives_map;
+        std::map<Float, AdjointsWindow> var_derivatives_map;
+        // Adjoints buffer used by Gather and ParallelSum and index of the node of its first element
+        std::vector<float> adjoints;
+        size_t adjoints_begin = 0;
+        // Per-thread adjoints buffers used by ParallelSum
+        std::vector<std::vector<float> > thread_adjoints;
+        // Per-thread tapes used by ParallelSum, kept between calls to reuse their chunks
+        std::vector<Tape> thread_tapes;
+
+        // Position in the unary, binary and n-ary streams of a Tape
+        struct StreamPositions {
+            size_t unary, binary, nary, nary_entries;
+        };
+
+        // Position of the streams after the nodes with index below end
+        static StreamPositions PositionsAt(Tape const &tape, size_t end);
+
+        // Add scale times the adjoints at the given indices to the gradient
+        void GatherAdjoints(size_t const *indices, size_t num_indices, float *gradient, float scale) const;
 
     public:
         Derivatives() = default;
@@ -25,12 +53,35 @@ namespace drdemo {
         // Clear derivatives
         void Clear();
 
-        // Compute derivatives for a given variable
+        // Compute derivatives for a given variable, the sweep stops at the lowest parameter registered on the tape
+        // so only the derivatives with respect to the nodes from there on are available
         void ComputeDerivatives(Float const &var);
 
         // Request derivative for a given outgoing variable with respect to a given input variable
         // Basically for df/dx, var_out is f and var_in x
         float Dwrt(Float const &f, Float const &x) const;
+
+        // Compute the derivatives of f with respect to the nodes at the given tape indices and add them, times scale,
+        // to gradient[0], ..., gradient[num_indices - 1]
+        void Gather(Float const &f, size_t const *indices, size_t num_indices, float *gradient, float scale = 1.f);
+
+        /**
+         * Evaluate in parallel a sum of terms over the range [begin, end). Each thread records
+         * term(chunk_begin, chunk_end) on a Tape forked from the calling thread one. When the calling tape is enabled
+         * the per-thread adjoints of the nodes recorded before the fork are merged, propagated back through the
+         * calling tape and the derivatives of the sum with respect to the nodes at the given tape indices are added,
+         * times scale, to the gradient like in Gather. Returns the sum of the terms
+         */
+        float ParallelSum(size_t begin, size_t end, std::function<Float(size_t, size_t)> const &term,
+                          size_t const *indices, size_t num_indices, float *gradient, float scale = 1.f);
+
+        // Traverse in reverse the nodes of the tape with index in [tape.BaseIndex(), end), propagating the adjoints
+        // to the parents. The adjoints are indexed with the tape indices and must be at least end long
+        static void Backpropagate(Tape const &tape, size_t end, std::vector<float> &adjoints);
+
+        // Same as above only for the nodes with index in [begin, end), the adjoint of the node at index i is
+        // adjoints[i - begin] and the contributions to the parents below begin are dropped
+        static void Backpropagate(Tape const &tape, size_t begin, size_t end, float *adjoints);
     };
 
 } // drdemo namespace
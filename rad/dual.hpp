@@ -0,0 +1,341 @@
+#ifndef DRDEMO_DUAL_HPP
+#define DRDEMO_DUAL_HPP
+
+/**
+ * Forward automatic differentiation tools
+ */
+
+#include <cstdlib>
+#include <cmath>
+#include <cassert>
+#include <iostream>
+
+namespace drdemo {
+
+    /**
+     * Define the Dual class, a value together with its derivatives along N tangent directions. The derivatives are
+     * propagated forward by each operation, nothing is recorded on the Tape so Dual and Float can be used side by side
+     *
+     * This is convenient for small blocks of parameters (the color of a light, a few SH coefficients) where
+     * N forward directions cost less than recording the whole computation and sweeping it back
+     */
+    template<size_t N>
+    class Dual {
+    private:
+        // Actual value
+        float value;
+        // Derivatives along each direction
+        float tangents[N];
+
+    public:
+        // Constant constructor, all the derivatives are zero
+        explicit Dual(float v = 0.f)
+                : value(v) {
+            for (size_t i = 0; i < N; ++i) { tangents[i] = 0.f; }
+        }
+
+        // Create the variable of a given direction, its derivative along it is one
+        static Dual Variable(float v, size_t direction) {
+            assert(direction < N);
+            Dual d(v);
+            d.tangents[direction] = 1.f;
+            return d;
+        }
+
+        // Access value
+        inline float GetValue() const noexcept { return value; }
+
+        inline void SetValue(float v) noexcept { value = v; }
+
+        // Access derivative along given direction
+        inline float Tangent(size_t direction) const {
+            assert(direction < N);
+            return tangents[direction];
+        }
+
+        inline void SetTangent(size_t direction, float t) {
+            assert(direction < N);
+            tangents[direction] = t;
+        }
+
+        // Number of directions
+        static constexpr size_t Directions() { return N; }
+
+        // Create a Dual given its value, the derivative of the operation with respect to the argument and the argument
+        static inline Dual Chain(float v, float d, Dual const &a) {
+            Dual r(v);
+            for (size_t i = 0; i < N; ++i) { r.tangents[i] = d * a.tangents[i]; }
+            return r;
+        }
+
+        // Same as above for an operation with two arguments
+        static inline Dual Chain(float v, float d_a, Dual const &a, float d_b, Dual const &b) {
+            Dual r(v);
+            for (size_t i = 0; i < N; ++i) { r.tangents[i] = d_a * a.tangents[i] + d_b * b.tangents[i]; }
+            return r;
+        }
+
+        // Math operators
+
+        // Negation
+        Dual operator-() const {
+            return Chain(-value, -1.f, *this);
+        }
+
+        // Addition
+        Dual operator+(Dual const &v) const {
+            return Chain(value + v.value, 1.f, *this, 1.f, v);
+        }
+
+        Dual operator+(float v) const {
+            Dual r(*this);
+            r.value += v;
+            return r;
+        }
+
+        // Subtraction
+        Dual operator-(Dual const &v) const {
+            return Chain(value - v.value, 1.f, *this, -1.f, v);
+        }
+
+        Dual operator-(float v) const {
+            Dual r(*this);
+            r.value -= v;
+            return r;
+        }
+
+        // Multiplication
+        Dual operator*(Dual const &v) const {
+            return Chain(value * v.value, v.value, *this, value, v);
+        }
+
+        Dual operator*(float v) const {
+            return Chain(value * v, v, *this);
+        }
+
+        // Division
+        Dual operator/(Dual const &v) const {
+            assert(v.value != 0.f);
+            const float inv_v = 1.f / v.value;
+            return Chain(value * inv_v, inv_v, *this, -value * inv_v * inv_v, v);
+        }
+
+        Dual operator/(float v) const {
+            assert(v != 0.f);
+            return Chain(value / v, 1.f / v, *this);
+        }
+
+        // Operators on self
+        Dual &operator+=(Dual const &v) {
+            value += v.value;
+            for (size_t i = 0; i < N; ++i) { tangents[i] += v.tangents[i]; }
+            return *this;
+        }
+
+        Dual &operator+=(float v) {
+            value += v;
+            return *this;
+        }
+
+        Dual &operator-=(Dual const &v) {
+            value -= v.value;
+            for (size_t i = 0; i < N; ++i) { tangents[i] -= v.tangents[i]; }
+            return *this;
+        }
+
+        Dual &operator-=(float v) {
+            value -= v;
+            return *this;
+        }
+
+        Dual &operator*=(Dual const &v) {
+            *this = *this * v;
+            return *this;
+        }
+
+        Dual &operator*=(float v) {
+            *this = *this * v;
+            return *this;
+        }
+
+        Dual &operator/=(Dual const &v) {
+            *this = *this / v;
+            return *this;
+        }
+
+        Dual &operator/=(float v) {
+            *this = *this / v;
+            return *this;
+        }
+    };
+
+    template<size_t N>
+    std::ostream &operator<<(std::ostream &os, Dual<N> const &d) {
+        os << d.GetValue() << " [";
+        for (size_t i = 0; i < N; ++i) { os << (i == 0 ? "" : ", ") << d.Tangent(i); }
+        os << "]";
+        return os;
+    }
+
+    // Convert to built-in float type
+    template<size_t N>
+    inline float Tofloat(Dual<N> const &d) { return d.GetValue(); }
+
+    /**
+     * Declare all the Dual mathematical operators
+     */
+
+    // Sum of float and Dual
+    template<size_t N>
+    inline Dual<N> operator+(float a, Dual<N> const &b) {
+        return b + a;
+    }
+
+    // Subtraction of float and Dual
+    template<size_t N>
+    inline Dual<N> operator-(float a, Dual<N> const &b) {
+        return Dual<N>::Chain(a - b.GetValue(), -1.f, b);
+    }
+
+    // Multiplication of float and Dual
+    template<size_t N>
+    inline Dual<N> operator*(float a, Dual<N> const &b) {
+        return b * a;
+    }
+
+    // Division of float and Dual
+    template<size_t N>
+    inline Dual<N> operator/(float a, Dual<N> const &b) {
+        assert(b.GetValue() != 0.f);
+        return Dual<N>::Chain(a / b.GetValue(), -a / (b.GetValue() * b.GetValue()), b);
+    }
+
+    // Comparison operators, only the values are compared
+    template<size_t N>
+    inline bool operator<(Dual<N> const &a, Dual<N> const &b) noexcept { return a.GetValue() < b.GetValue(); }
+
+    template<size_t N>
+    inline bool operator<(Dual<N> const &a, float b) noexcept { return a.GetValue() < b; }
+
+    template<size_t N>
+    inline bool operator<(float a, Dual<N> const &b) noexcept { return a < b.GetValue(); }
+
+    template<size_t N>
+    inline bool operator<=(Dual<N> const &a, Dual<N> const &b) noexcept { return a.GetValue() <= b.GetValue(); }
+
+    template<size_t N>
+    inline bool operator<=(Dual<N> const &a, float b) noexcept { return a.GetValue() <= b; }
+
+    template<size_t N>
+    inline bool operator<=(float a, Dual<N> const &b) noexcept { return a <= b.GetValue(); }
+
+    template<size_t N>
+    inline bool operator>(Dual<N> const &a, Dual<N> const &b) noexcept { return a.GetValue() > b.GetValue(); }
+
+    template<size_t N>
+    inline bool operator>(Dual<N> const &a, float b) noexcept { return a.GetValue() > b; }
+
+    template<size_t N>
+    inline bool operator>(float a, Dual<N> const &b) noexcept { return a > b.GetValue(); }
+
+    template<size_t N>
+    inline bool operator>=(Dual<N> const &a, Dual<N> const &b) noexcept { return a.GetValue() >= b.GetValue(); }
+
+    template<size_t N>
+    inline bool operator>=(Dual<N> const &a, float b) noexcept { return a.GetValue() >= b; }
+
+    template<size_t N>
+    inline bool operator>=(float a, Dual<N> const &b) noexcept { return a >= b.GetValue(); }
+
+    template<size_t N>
+    inline bool operator==(Dual<N> const &a, Dual<N> const &b) noexcept { return a.GetValue() == b.GetValue(); }
+
+    template<size_t N>
+    inline bool operator==(Dual<N> const &a, float b) noexcept { return a.GetValue() == b; }
+
+    template<size_t N>
+    inline bool operator==(float a, Dual<N> const &b) noexcept { return a == b.GetValue(); }
+
+    template<size_t N>
+    inline bool operator!=(Dual<N> const &a, Dual<N> const &b) noexcept { return a.GetValue() != b.GetValue(); }
+
+    template<size_t N>
+    inline bool operator!=(Dual<N> const &a, float b) noexcept { return a.GetValue() != b; }
+
+    template<size_t N>
+    inline bool operator!=(float a, Dual<N> const &b) noexcept { return a != b.GetValue(); }
+
+    // Sign of Dual
+    template<size_t N>
+    inline int Sign(Dual<N> const &v) noexcept {
+        return static_cast<int>((0.f < v.GetValue()) - (v.GetValue() < 0.f));
+    }
+
+    // Sin of Dual
+    template<size_t N>
+    inline Dual<N> Sin(Dual<N> const &v) {
+        return Dual<N>::Chain(std::sin(v.GetValue()), std::cos(v.GetValue()), v);
+    }
+
+    // Cos of Dual
+    template<size_t N>
+    inline Dual<N> Cos(Dual<N> const &v) {
+        return Dual<N>::Chain(std::cos(v.GetValue()), -std::sin(v.GetValue()), v);
+    }
+
+    // Tan of Dual
+    template<size_t N>
+    inline Dual<N> Tan(Dual<N> const &v) {
+        return Dual<N>::Chain(std::tan(v.GetValue()), 2.f / (std::cos(2.f * v.GetValue()) + 1.f), v);
+    }
+
+    // Exp of Dual
+    template<size_t N>
+    inline Dual<N> Exp(Dual<N> const &v) {
+        const float e = std::exp(v.GetValue());
+        return Dual<N>::Chain(e, e, v);
+    }
+
+    // Log of Dual
+    template<size_t N>
+    inline Dual<N> Log(Dual<N> const &v) {
+        assert(v > 0.f);
+        return Dual<N>::Chain(std::log(v.GetValue()), 1.f / v.GetValue(), v);
+    }
+
+    // Pow of Dual
+    template<size_t N>
+    inline Dual<N> Pow(Dual<N> const &v, float k) {
+        return Dual<N>::Chain(std::pow(v.GetValue(), k), k * std::pow(v.GetValue(), k - 1.f), v);
+    }
+
+    // Sqrt of Dual
+    template<size_t N>
+    inline Dual<N> Sqrt(Dual<N> const &v) {
+        assert(v != 0.f);
+        const float s = std::sqrt(v.GetValue());
+        return Dual<N>::Chain(s, 0.5f / s, v);
+    }
+
+    // Abs of Dual
+    template<size_t N>
+    inline Dual<N> Abs(Dual<N> const &v) {
+        assert(v != 0.f);
+        return Dual<N>::Chain(std::abs(v.GetValue()), static_cast<float>(Sign(v)), v);
+    }
+
+    // Max of two Dual
+    template<size_t N>
+    inline Dual<N> Max(Dual<N> const &a, Dual<N> const &b) {
+        return (a.GetValue() > b.GetValue() ? a : b);
+    }
+
+    // Min of two Dual
+    template<size_t N>
+    inline Dual<N> Min(Dual<N> const &a, Dual<N> const &b) {
+        return (a.GetValue() < b.GetValue() ? a : b);
+    }
+
+} // drdemo namespace
+
+#endif //DRDEMO_DUAL_HPP
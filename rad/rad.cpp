@@ -3,64 +3,255 @@
 //
 
 #include "rad.hpp"
+#include "tape_profiler.hpp"
 
 namespace drdemo {
 
     // Initialize default tape
     Tape default_tape = Tape();
 
-    TapeNode::TapeNode(float w1, size_t p1, float w2, size_t p2) noexcept {
-        assert(!std::isnan(w1));
-        assert(!std::isnan(w2));
-        assert(!std::isinf(w1));
-        assert(!std::isinf(w2));
-        // Set first child
-        weights[0] = w1;
-        parent_i[0] = p1;
-        // Set second child
-        weights[1] = w2;
-        parent_i[1] = p2;
+    // Every thread starts recording on the default tape
+    thread_local Tape *current_tape = &default_tape;
+
+    Tape::Tape(size_t chunk_size, size_t base)
+            : kinds(chunk_size), unary_nodes(chunk_size), binary_nodes(chunk_size), nary_counts(chunk_size),
+              nary_entries(chunk_size), base_index(base), enabled(true), peak_nodes(0), peak_bytes(0) {}
+
+    Tape Tape::Fork(size_t chunk_size) const {
+        Tape forked(chunk_size, Size());
+        forked.enabled = enabled;
+        return forked;
+    }
+
+    void Tape::Rebase(Tape const &parent) {
+        kinds.Cut(0);
+        unary_nodes.Cut(0);
+        binary_nodes.Cut(0);
+        nary_counts.Cut(0);
+        nary_entries.Cut(0);
+        checkpoints.clear();
+        parameters.clear();
+        base_index = parent.Size();
+        enabled = parent.enabled;
+        peak_nodes = 0;
+        peak_bytes = 0;
+    }
+
+    void Tape::DropParameters(size_t starting_index) {
+        parameters.erase(parameters.lower_bound(starting_index), parameters.end());
+    }
+
+    void Tape::RegisterParameters(size_t first, size_t count) {
+        if (first != NOT_REGISTERED && count > 0) { parameters[first] = count; }
+    }
+
+    void Tape::UnregisterParameters(size_t first) {
+        parameters.erase(first);
+    }
+
+    size_t Tape::LowestParameter() const {
+        return parameters.empty() ? base_index : parameters.begin()->first;
+    }
+
+    TapeStats Tape::Content() const {
+        TapeStats content;
+        content.unary = unary_nodes.Size();
+        content.binary = binary_nodes.Size();
+        content.nary = nary_counts.Size();
+        content.nary_entries = nary_entries.Size();
+        content.leaves = kinds.Size() - content.unary - content.binary - content.nary;
+        return content;
+    }
+
+    void Tape::Observe() {
+        const TapeStats content = Content();
+        const size_t nodes = content.Nodes();
+        const size_t bytes = content.Bytes();
+        peak_nodes = std::max(peak_nodes, nodes);
+        peak_bytes = std::max(peak_bytes, bytes);
+        if (!checkpoints.empty()) {
+            checkpoints.back().peak_nodes = std::max(checkpoints.back().peak_nodes, nodes);
+            checkpoints.back().peak_bytes = std::max(checkpoints.back().peak_bytes, bytes);
+        }
+        if (TapeProfiler::IsEnabled()) { TapeProfiler::Observe(nodes, bytes); }
+    }
+
+    void Tape::Push() {
+        if (enabled) {
+            const TapeStats content = Content();
+            checkpoints.push_back({Size(), unary_nodes.Size(), binary_nodes.Size(), nary_counts.Size(),
+                                   nary_entries.Size(), content.Nodes(), content.Bytes()});
+        }
+    }
+
+    void Tape::Pop() {
+        if (enabled) {
+            Observe();
+            Checkpoint const checkpoint = checkpoints.back();
+            // Delete checkpoint, the enclosing one has seen the same peaks
+            checkpoints.pop_back();
+            if (!checkpoints.empty()) {
+                checkpoints.back().peak_nodes = std::max(checkpoints.back().peak_nodes, checkpoint.peak_nodes);
+                checkpoints.back().peak_bytes = std::max(checkpoints.back().peak_bytes, checkpoint.peak_bytes);
+            }
+            if (TapeProfiler::IsEnabled()) {
+                // Nodes recorded since the checkpoint
+                TapeStats region;
+                region.records = 1;
+                region.unary = unary_nodes.Size() - checkpoint.unary;
+                region.binary = binary_nodes.Size() - checkpoint.binary;
+                region.nary = nary_counts.Size() - checkpoint.nary;
+                region.nary_entries = nary_entries.Size() - checkpoint.nary_entries;
+                region.leaves = Size() - checkpoint.nodes - region.unary - region.binary - region.nary;
+                region.peak_nodes = checkpoint.peak_nodes;
+                region.peak_bytes = checkpoint.peak_bytes;
+                TapeProfiler::Record(TapeProfiler::CurrentScope(), region);
+            }
+            DropParameters(checkpoint.nodes);
+            kinds.Cut(checkpoint.nodes - base_index);
+            unary_nodes.Cut(checkpoint.unary);
+            binary_nodes.Cut(checkpoint.binary);
+            nary_counts.Cut(checkpoint.nary);
+            nary_entries.Cut(checkpoint.nary_entries);
+        }
     }
 
-    Tape::Tape(size_t starting_size) : nodes(starting_size), enabled(true) {}
+    TapeStats Tape::Stats() const {
+        TapeStats stats = Content();
+        stats.records = 1;
+        stats.peak_nodes = std::max(peak_nodes, stats.Nodes());
+        stats.peak_bytes = std::max(peak_bytes, stats.Bytes());
+        return stats;
+    }
 
     void Tape::Clear(size_t starting_index) {
-        nodes.Cut(starting_index);
+        assert(starting_index >= base_index && starting_index <= Size());
+        Observe();
+        // Find how many unary, binary and n-ary nodes are after the starting index
+        size_t unary = unary_nodes.Size();
+        size_t binary = binary_nodes.Size();
+        size_t nary = nary_counts.Size();
+        for (size_t i = starting_index - base_index; i < kinds.Size(); ++i) {
+            if (kinds[i] == NodeKind::UNARY) { unary--; }
+            else if (kinds[i] == NodeKind::BINARY) { binary--; }
+            else if (kinds[i] == NodeKind::NARY) { nary--; }
+        }
+        // Remove the parents of the n-ary nodes that are cut
+        size_t nary_entries_size = nary_entries.Size();
+        for (size_t i = nary; i < nary_counts.Size(); ++i) { nary_entries_size -= nary_counts[i]; }
+        DropParameters(starting_index);
+        kinds.Cut(starting_index - base_index);
+        unary_nodes.Cut(unary);
+        binary_nodes.Cut(binary);
+        nary_counts.Cut(nary);
+        nary_entries.Cut(nary_entries_size);
+    }
+
+    size_t Tape::PushKind(NodeKind kind) {
+        size_t const index = Size();
+#ifdef RAD_COMPACT_TAPE
+        if (index >= NOT_REGISTERED_PARENT) {
+            std::cerr << "Tape exceeded the maximum number of nodes of the compact mode!" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+#endif
+        kinds.Append(kind);
+        return index;
     }
 
     size_t Tape::PushLeaf() {
         if (enabled) {
-            size_t const index = Size();
-            nodes.Append(TapeNode(0.f, index, 0.f, index));
-            return index;
+            return PushKind(NodeKind::LEAF);
         } else {
             return NOT_REGISTERED;
         }
     }
 
-    size_t Tape::PushSingleNode(float w, size_t p) {
+    size_t Tape::PushLeaves(size_t n) {
         if (enabled) {
-            size_t const index = Size();
-            nodes.Append(TapeNode(w, p, 0.f, index));
-            return index;
+            const size_t first = Size();
+#ifdef RAD_COMPACT_TAPE
+            if (first + n > NOT_REGISTERED_PARENT) {
+                std::cerr << "Tape exceeded the maximum number of nodes of the compact mode!" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+#endif
+            // The leaves have no data besides their kind, append them all at once
+            kinds.AppendCopies(NodeKind::LEAF, n);
+            return first;
+        } else {
+            return NOT_REGISTERED;
+        }
+    }
+
+    size_t Tape::PushSingleNode(float w, size_t p) {
+        if (enabled && p != NOT_REGISTERED) {
+            assert(!std::isnan(w) && !std::isinf(w));
+            unary_nodes.Append({w, ToTapeIndex(p)});
+            return PushKind(NodeKind::UNARY);
         } else {
             return NOT_REGISTERED;
         }
     }
 
     size_t Tape::PushTwoNode(float w1, size_t p1, float w2, size_t p2) {
+        // A constant parent does not need to be recorded
+        if (p1 == NOT_REGISTERED) { return PushSingleNode(w2, p2); }
+        if (p2 == NOT_REGISTERED) { return PushSingleNode(w1, p1); }
         if (enabled) {
-            size_t const index = Size();
-            nodes.Append(TapeNode(w1, p1, w2, p2));
-            return index;
+            assert(!std::isnan(w1) && !std::isinf(w1));
+            assert(!std::isnan(w2) && !std::isinf(w2));
+            binary_nodes.Append({{w1, w2}, {ToTapeIndex(p1), ToTapeIndex(p2)}});
+            return PushKind(NodeKind::BINARY);
         } else {
             return NOT_REGISTERED;
         }
     }
 
-    Float::Float(float v)
-    // Set the value of the variable and push it on the default_tape
-            : value(v), node_index(default_tape.PushLeaf()) {}
+    size_t Tape::PushNaryNode(size_t n, float const *w, size_t const *p) {
+        if (!enabled) { return NOT_REGISTERED; }
+        // Count the active parents, the constant ones are not recorded
+        size_t active = 0;
+        size_t last_active = 0;
+        for (size_t i = 0; i < n; ++i) {
+            if (p[i] != NOT_REGISTERED) {
+                active++;
+                last_active = i;
+            }
+        }
+        if (active == 0) { return NOT_REGISTERED; }
+        if (active == 1) { return PushSingleNode(w[last_active], p[last_active]); }
+        for (size_t i = 0; i < n; ++i) {
+            if (p[i] != NOT_REGISTERED) {
+                assert(!std::isnan(w[i]) && !std::isinf(w[i]));
+                nary_entries.Append({w[i], ToTapeIndex(p[i])});
+            }
+        }
+        nary_counts.Append(static_cast<uint32_t>(active));
+        return PushKind(NodeKind::NARY);
+    }
+
+    Float::Float(float v) noexcept
+            : value(v), node_index(NOT_REGISTERED) {}
+
+    Float Float::Variable(float v) {
+        // Set the value of the variable and push it on the current tape
+        const size_t index = CurrentTape().PushLeaf();
+        CurrentTape().RegisterParameters(index, 1);
+        return Float(index, v);
+    }
+
+    void Float::RegisterVariables(Float *vars, size_t n) {
+        const size_t first = CurrentTape().PushLeaves(n);
+        CurrentTape().RegisterParameters(first, n);
+        for (size_t i = 0; i < n; ++i) {
+            vars[i].node_index = (first == NOT_REGISTERED ? NOT_REGISTERED : first + i);
+        }
+    }
+
+    void Float::UnregisterVariables(Float const *vars) {
+        if (vars[0].IsActive()) { CurrentTape().UnregisterParameters(vars[0].NodeIndex()); }
+    }
 
     Float::Float(size_t index, float v) noexcept
             : value(v), node_index(index) {}
@@ -72,7 +263,8 @@ namespace drdemo {
         if (this != &other) {
             value = other.value;
 #ifdef FLOAT_NO_ALIAS
-            node_index = default_tape.PushLeaf();
+            // Constants stay constants
+            node_index = other.IsActive() ? CurrentTape().PushLeaf() : NOT_REGISTERED;
 #else
             node_index = other.node_index;
 #endif
@@ -10,48 +10,166 @@
  */
 
 #include <cstdlib>
+#include <cstdint>
 #include <cmath>
 #include <vector>
+#include <map>
 #include <iostream>
 #include <cassert>
+#include <limits>
+#include <algorithm>
 #include <tape_storage.hpp>
 
 namespace drdemo {
 
+#ifdef RAD_COMPACT_TAPE
+    // Compact tape mode, the parent indices are stored on 32 bits so the tape can hold up to 2^32 - 1 nodes
+    using TapeIndex = uint32_t;
+#else
+    using TapeIndex = size_t;
+#endif
+
+    // Define constant that is returned as index from the tape if the node was not registered. A Float with this
+    // index is a constant: it is not recorded on the tape and its operations only record the active operands
+    const size_t NOT_REGISTERED = std::numeric_limits<size_t>::max();
+
+    // Parent index stored in the tape for a parent that was not registered
+    const TapeIndex NOT_REGISTERED_PARENT = std::numeric_limits<TapeIndex>::max();
+
     /**
-     * Define the TapeNode struct, used internally to build the tape that allows to compute
-     * the derivatives in reverse mode
+     * Kind of a tape node, tells the reverse sweep in which stream the parents of the node are stored.
+     * Leaf nodes have no parents and are only recorded in the kinds stream
      */
-    struct TapeNode {
-        // Weight associated with the respective nodes
-        float weights[2];
-        // Parent node indices in the tape
-        size_t parent_i[2];
+    enum class NodeKind : uint8_t {
+        LEAF, UNARY, BINARY, NARY
+    };
 
-        TapeNode() = default;
+    /**
+     * Define the UnaryNode and BinaryNode structs, used internally to build the tape that allows to compute
+     * the derivatives in reverse mode. Each one stores the weights of the node with respect to its parents
+     * and the parents indices in the tape
+     */
+    struct UnaryNode {
+        float weight;
+        TapeIndex parent_i;
+    };
 
-        TapeNode(float w1, size_t p1, float w2, size_t p2) noexcept;
+    struct BinaryNode {
+        float weights[2];
+        TapeIndex parent_i[2];
     };
 
-    // Define constant that is returned as index from the tape if the node was not registered
-    const size_t NOT_REGISTERED = std::numeric_limits<size_t>::max();
+    // Maximum number of parents of a n-ary node
+    const size_t MAX_NARY_PARENTS = 32;
+
+    /**
+     * Statistics about the nodes recorded on a Tape, collected by the TapeProfiler. The peaks are the largest
+     * content of the Tape observed while the nodes were recorded
+     */
+    struct TapeStats {
+        // Number of times statistics were added
+        size_t records;
+        // Number of nodes of each kind and total number of parents of the n-ary nodes
+        size_t leaves, unary, binary, nary, nary_entries;
+        // Peak number of nodes and memory of the Tape
+        size_t peak_nodes, peak_bytes;
+
+        TapeStats()
+                : records(0), leaves(0), unary(0), binary(0), nary(0), nary_entries(0), peak_nodes(0),
+                  peak_bytes(0) {}
+
+        // Total number of nodes
+        inline size_t Nodes() const { return leaves + unary + binary + nary; }
+
+        // Memory used to store the nodes
+        inline size_t Bytes() const {
+            return Nodes() * sizeof(NodeKind) + unary * sizeof(UnaryNode) + binary * sizeof(BinaryNode) +
+                   nary * sizeof(uint32_t) + nary_entries * sizeof(UnaryNode);
+        }
+
+        // Accumulate other statistics, the counts are summed and the peaks are the largest ones
+        inline TapeStats &operator+=(TapeStats const &other) {
+            records += other.records;
+            leaves += other.leaves;
+            unary += other.unary;
+            binary += other.binary;
+            nary += other.nary;
+            nary_entries += other.nary_entries;
+            peak_nodes = std::max(peak_nodes, other.peak_nodes);
+            peak_bytes = std::max(peak_bytes, other.peak_bytes);
+            return *this;
+        }
+    };
 
     /**
      * Define the Tape class which holds the computation progress and allows then to compute the derivatives
+     *
+     * The nodes are stored in streams: the kind of every node in index order and, separately, the unary and
+     * binary nodes in the order they were recorded. A n-ary node stores its number of parents in the counts stream
+     * and each (weight, parent) pair as a UnaryNode in the entries stream. The reverse sweep walks the kinds
+     * backwards and pops the parents from the end of the corresponding stream
+     *
+     * A Tape can be forked from another one to record on a different thread, the forked Tape starts numbering its
+     * nodes from the size of the parent one (the base index) so the nodes can still reference the parent nodes
+     * recorded before the fork, like the differentiable variables of the scene
+     *
+     * The streams grow by fixed size chunks that are kept when the Tape is cleared or popped, after the first
+     * iteration of an optimization nothing is allocated anymore
      */
     class Tape {
     private:
-        // List of Tape nodes
-        // std::vector<TapeNode> nodes;
-        TapeStorage<TapeNode> nodes;
+        // Size of the streams at a given point of the recording
+        struct Checkpoint {
+            size_t nodes, unary, binary, nary, nary_entries;
+            // Largest content of the Tape observed since the checkpoint was pushed
+            size_t peak_nodes, peak_bytes;
+        };
+
+        // Kind of each node of the Tape
+        TapeStorage<NodeKind> kinds;
+        // Unary and binary nodes streams
+        TapeStorage<UnaryNode> unary_nodes;
+        TapeStorage<BinaryNode> binary_nodes;
+        // Number of parents of each n-ary node and their weights and indices
+        TapeStorage<uint32_t> nary_counts;
+        TapeStorage<UnaryNode> nary_entries;
         // List of checkpoints to reset the nodes to a certain point
-        std::vector<size_t> clear_indices;
+        std::vector<Checkpoint> checkpoints;
+        // Index of the first node stored in this Tape, the nodes below belong to the Tape this one was forked from
+        size_t base_index;
         // Boolean flag to check if the Tape is enabled or not
         bool enabled;
+        // Largest content of the Tape observed since it was created or rebased
+        size_t peak_nodes, peak_bytes;
+        // Registered parameters, index of the first leaf of each block and number of leaves in it
+        std::map<size_t, size_t> parameters;
+
+        // Convert index to the type stored in the tape
+        static inline TapeIndex ToTapeIndex(size_t index) {
+            return index == NOT_REGISTERED ? NOT_REGISTERED_PARENT : static_cast<TapeIndex>(index);
+        }
+
+        // Register the kind of a new node and return its index
+        size_t PushKind(NodeKind kind);
+
+        // Count the nodes stored in this Tape
+        TapeStats Content() const;
+
+        // Forget the parameters blocks that start at or after the given index, called when the Tape is cut
+        void DropParameters(size_t starting_index);
+
+        // Update the peaks with the current content, called before the Tape shrinks
+        void Observe();
 
     public:
-        // Tape default constructor
-        explicit Tape(size_t starting_size = 1024);
+        // Tape default constructor, the streams grow by chunks of chunk_size nodes
+        explicit Tape(size_t chunk_size = 1 << 16, size_t base = 0);
+
+        // Create a new Tape whose nodes start after the current ones, with the same enabled status
+        Tape Fork(size_t chunk_size = 1 << 16) const;
+
+        // Clear the Tape and restart it as a fork of the given one, the allocated chunks are kept for reuse
+        void Rebase(Tape const &parent);
 
         // Enable / Disable tape
         inline void Enable() { enabled = true; }
@@ -61,33 +179,45 @@ namespace drdemo {
         // Check if the Tape is enabled
         inline bool IsEnabled() const { return enabled; }
 
-        // Access TapeNode at given index
-        inline TapeNode const &At(size_t index) const {
-            // return nodes.at(index);
-            return nodes.At(index);
-        }
+        // Access kind of the node at given index, the index must not be below the base index
+        inline NodeKind Kind(size_t index) const { return kinds.At(index - base_index); }
+
+        // Access unary and binary nodes in recording order
+        inline UnaryNode const &Unary(size_t i) const { return unary_nodes.At(i); }
+
+        inline BinaryNode const &Binary(size_t i) const { return binary_nodes.At(i); }
+
+        // Access number of parents of the n-ary nodes in recording order and their parents entries
+        inline size_t NaryCount(size_t i) const { return nary_counts.At(i); }
+
+        inline UnaryNode const &NaryEntry(size_t i) const { return nary_entries.At(i); }
+
+        // Number of unary, binary and n-ary nodes
+        inline size_t NumUnary() const { return unary_nodes.Size(); }
 
-        // Get size of the Tape
+        inline size_t NumBinary() const { return binary_nodes.Size(); }
+
+        inline size_t NumNary() const { return nary_counts.Size(); }
+
+        inline size_t NumNaryEntries() const { return nary_entries.Size(); }
+
+        // Get index of the first node stored in this Tape
+        inline size_t BaseIndex() const { return base_index; }
+
+        // Get size of the Tape, including the nodes below the base index
         inline size_t Size() const {
-            // return nodes.size();
-            return nodes.Size();
+            return base_index + kinds.Size();
         }
 
         // Push current size of nodes, can be used to clear after
-        inline void Push() {
-            if (enabled) {
-                clear_indices.push_back(nodes.Size());
-            }
-        }
+        void Push();
 
-        // Pop current portion of stack, uses last checkpoint saved
-        inline void Pop() {
-            if (enabled) {
-                nodes.Cut(clear_indices[clear_indices.size() - 1]);
-                // Delete index
-                clear_indices.pop_back();
-            }
-        }
+        // Pop current portion of stack, uses last checkpoint saved. When the TapeProfiler is enabled the nodes of the
+        // portion are recorded in the current profiler scope
+        void Pop();
+
+        // Statistics of the current content of the Tape and its peaks
+        TapeStats Stats() const;
 
         // Clear tape starting from a given index
         void Clear(size_t starting_index);
@@ -95,30 +225,90 @@ namespace drdemo {
         // Push a Zero value node (leaf node), returns the index of the node on the Tape
         size_t PushLeaf();
 
+        // Push n leaf nodes with contiguous indices, returns the index of the first one
+        size_t PushLeaves(size_t n);
+
+        // The following methods skip the parents that are NOT_REGISTERED (constants) and return NOT_REGISTERED
+        // without recording anything when no parent is left, a node with a single active parent is recorded as unary
+
         // Push a node that depends only on another single node given the value of the node and the parent index
         size_t PushSingleNode(float w, size_t p);
 
         // Push a node that depends on two children given both the values and the parents indices
         size_t PushTwoNode(float w1, size_t p1, float w2, size_t p2);
+
+        // Push a node that depends on n parents given the weights and the parents indices, can be used to record
+        // a whole expression as a single node when its partial derivatives are known
+        size_t PushNaryNode(size_t n, float const *w, size_t const *p);
+
+        // Register the count leaves starting at first as a block of parameters, the ones we differentiate with
+        // respect to. No derivative can flow from a node to a lower index so the reverse sweeps stop at the lowest
+        // registered parameter
+        void RegisterParameters(size_t first, size_t count);
+
+        // Remove the block of parameters starting at first, when its variables are not used anymore
+        void UnregisterParameters(size_t first);
+
+        // Index of the lowest registered parameter still on the Tape, the base index if there are none
+        size_t LowestParameter() const;
     };
 
     // Declare extern Tape variable
     extern Tape default_tape;
 
+    // Tape used by the Float operations of the calling thread, default_tape unless a TapeScope is active
+    extern thread_local Tape *current_tape;
+
+    inline Tape &CurrentTape() { return *current_tape; }
+
+    /**
+     * Bind a Tape to the calling thread for the lifetime of the object, all the Float operations of the thread
+     * are recorded on it. The previously bound Tape is restored on destruction
+     */
+    class TapeScope {
+    private:
+        // Tape bound before this one
+        Tape *previous;
+
+    public:
+        explicit TapeScope(Tape &tape)
+                : previous(current_tape) { current_tape = &tape; }
+
+        TapeScope(TapeScope const &other) = delete;
+
+        TapeScope &operator=(TapeScope const &other) = delete;
+
+        ~TapeScope() { current_tape = previous; }
+    };
+
     /**
      * Define Float class that allows to do classical float computations while building the tape
      * structure for the reverse differentiation process
+     *
+     * A Float built from a value is a constant and is not recorded on the tape, only the values we differentiate
+     * with respect to must be created as variables with Variable or RegisterVariables. Operations between
+     * constants record nothing and operations mixing constants and active values only record the active parents
      */
     class Float {
     private:
         // Actual value
         float value;
-        // Index to the node in the tape
+        // Index to the node in the tape, NOT_REGISTERED for constants
         size_t node_index;
 
     public:
-        // GetValue constructor, default value is 0
-        explicit Float(float v = 0.f);
+        // GetValue constructor, creates a constant, default value is 0
+        explicit Float(float v = 0.f) noexcept;
+
+        // Create a differentiable variable with the given value, a new leaf on the current tape
+        static Float Variable(float v);
+
+        // Make the n given Floats differentiable variables, they get contiguous leaves on the current tape and are
+        // registered as a block of parameters
+        static void RegisterVariables(Float *vars, size_t n);
+
+        // Unregister the parameters block of variables created with RegisterVariables, once they are not used
+        static void UnregisterVariables(Float const *vars);
 
         // Construct Float given index on tape and value
         Float(size_t index, float v) noexcept;
@@ -140,20 +330,23 @@ namespace drdemo {
         // Get node index
         inline size_t NodeIndex() const noexcept { return node_index; }
 
+        // Check if the Float is recorded on the tape, false for constants
+        inline bool IsActive() const noexcept { return node_index != NOT_REGISTERED; }
+
         // Math operators
 
         // Negation
         Float operator-() const {
-            return Float(default_tape.PushSingleNode(-1.f, node_index), -value);
+            return Float(CurrentTape().PushSingleNode(-1.f, node_index), -value);
         }
 
         // Addition
         Float operator+(Float const &v) const {
-            return Float(default_tape.PushTwoNode(1.f, node_index, 1.f, v.NodeIndex()), value + v.GetValue());
+            return Float(CurrentTape().PushTwoNode(1.f, node_index, 1.f, v.NodeIndex()), value + v.GetValue());
         }
 
         Float operator+(float v) {
-            return Float(default_tape.PushSingleNode(1.f, node_index), value + v);
+            return Float(CurrentTape().PushSingleNode(1.f, node_index), value + v);
         }
 
         // Operators on self
@@ -174,11 +367,11 @@ namespace drdemo {
 
         // Subtraction
         Float operator-(Float const &v) const {
-            return Float(default_tape.PushTwoNode(1.f, node_index, -1.f, v.NodeIndex()), value - v.GetValue());
+            return Float(CurrentTape().PushTwoNode(1.f, node_index, -1.f, v.NodeIndex()), value - v.GetValue());
         }
 
         Float operator-(float v) const {
-            return Float(default_tape.PushSingleNode(1.f, node_index), value - v);
+            return Float(CurrentTape().PushSingleNode(1.f, node_index), value - v);
         }
 
         Float &operator-=(Float const &v) {
@@ -193,26 +386,26 @@ namespace drdemo {
 
         // Multiplication
         Float operator*(Float const &v) const {
-            return Float(default_tape.PushTwoNode(v.GetValue(), node_index, value, v.NodeIndex()),
+            return Float(CurrentTape().PushTwoNode(v.GetValue(), node_index, value, v.NodeIndex()),
                          value * v.GetValue());
         }
 
         Float operator*(float v) const {
-            return Float(default_tape.PushSingleNode(v, node_index), value * v);
+            return Float(CurrentTape().PushSingleNode(v, node_index), value * v);
         }
 
         // Division
         Float operator/(Float const &v) const {
             assert(v.GetValue() != 0.f);
             // If f(a,b) = a/b, then df/da = 1/b and df/db = -a/(b*b)
-            return Float(default_tape.PushTwoNode(1.f / v.GetValue(), node_index,
+            return Float(CurrentTape().PushTwoNode(1.f / v.GetValue(), node_index,
                                                   -value / (v.GetValue() * v.GetValue()), v.NodeIndex()),
                          value / v.GetValue());
         }
 
         Float operator/(float v) const {
             assert(v != 0.f);
-            return Float(default_tape.PushSingleNode(1.f / v, node_index), value / v);
+            return Float(CurrentTape().PushSingleNode(1.f / v, node_index), value / v);
         }
     };
 
@@ -224,23 +417,32 @@ namespace drdemo {
 
     // Sum of float and Float
     inline Float operator+(float a, Float const &b) {
-        return Float(default_tape.PushSingleNode(1.f, b.NodeIndex()), a + b.GetValue());
+        return Float(CurrentTape().PushSingleNode(1.f, b.NodeIndex()), a + b.GetValue());
     }
 
     // Subtraction of float and Float
     inline Float operator-(float a, Float const &b) {
-        return Float(default_tape.PushSingleNode(-1.f, b.NodeIndex()), a - b.GetValue());
+        return Float(CurrentTape().PushSingleNode(-1.f, b.NodeIndex()), a - b.GetValue());
     }
 
     // Multiplication of float and Float
     inline Float operator*(float a, Float const &b) {
-        return Float(default_tape.PushSingleNode(a, b.NodeIndex()), a * b.GetValue());
+        return Float(CurrentTape().PushSingleNode(a, b.NodeIndex()), a * b.GetValue());
     }
 
     // Division of float and Float
     inline Float operator/(float a, Float const &b) {
         assert(b.GetValue() != 0.f);
-        return Float(default_tape.PushSingleNode(-a / (b.GetValue() * b.GetValue()), b.NodeIndex()), a / b.GetValue());
+        return Float(CurrentTape().PushSingleNode(-a / (b.GetValue() * b.GetValue()), b.NodeIndex()), a / b.GetValue());
+    }
+
+    // Create a Float given its value and the partial derivatives with respect to n parents, the expression is
+    // recorded on the tape as a single node
+    inline Float FusedNode(float value, size_t n, float const *partials, Float const *const *parents) {
+        assert(n <= MAX_NARY_PARENTS);
+        size_t parents_i[MAX_NARY_PARENTS];
+        for (size_t i = 0; i < n; ++i) { parents_i[i] = parents[i]->NodeIndex(); }
+        return Float(CurrentTape().PushNaryNode(n, partials, parents_i), value);
     }
 
     // Comparison operator
@@ -330,48 +532,48 @@ namespace drdemo {
 
     // Sin of Float
     inline Float Sin(Float const &v) {
-        return Float(default_tape.PushSingleNode(std::cos(v.GetValue()), v.NodeIndex()), std::sin(v.GetValue()));
+        return Float(CurrentTape().PushSingleNode(std::cos(v.GetValue()), v.NodeIndex()), std::sin(v.GetValue()));
     }
 
     // Cos of Float
     inline Float Cos(Float const &v) {
-        return Float(default_tape.PushSingleNode(-std::sin(v.GetValue()), v.NodeIndex()), std::cos(v.GetValue()));
+        return Float(CurrentTape().PushSingleNode(-std::sin(v.GetValue()), v.NodeIndex()), std::cos(v.GetValue()));
     }
 
     // Tan of Float
     inline Float Tan(Float const &v) {
-        return Float(default_tape.PushSingleNode(2.f / (std::cos(2.f * v.GetValue()) + 1.f), v.NodeIndex()),
+        return Float(CurrentTape().PushSingleNode(2.f / (std::cos(2.f * v.GetValue()) + 1.f), v.NodeIndex()),
                      std::tan(v.GetValue()));
     }
 
     // Exp of Float
     inline Float Exp(Float const &v) {
-        return Float(default_tape.PushSingleNode(std::exp(v.GetValue()), v.NodeIndex()), std::exp(v.GetValue()));
+        return Float(CurrentTape().PushSingleNode(std::exp(v.GetValue()), v.NodeIndex()), std::exp(v.GetValue()));
     }
 
     // Log of Float
     inline Float Log(Float const &v) {
         assert(v > 0.f);
-        return Float(default_tape.PushSingleNode(1.f / v.GetValue(), v.NodeIndex()), std::log(v.GetValue()));
+        return Float(CurrentTape().PushSingleNode(1.f / v.GetValue(), v.NodeIndex()), std::log(v.GetValue()));
     }
 
     // Pow of Float
     inline Float Pow(Float const &v, float k) {
-        return Float(default_tape.PushSingleNode(k * std::pow(v.GetValue(), k - 1.f), v.NodeIndex()),
+        return Float(CurrentTape().PushSingleNode(k * std::pow(v.GetValue(), k - 1.f), v.NodeIndex()),
                      std::pow(v.GetValue(), k));
     }
 
     // Sqrt of Float
     inline Float Sqrt(Float const &v) {
         assert(v != 0.f);
-        return Float(default_tape.PushSingleNode(0.5f / std::sqrt(v.GetValue()), v.NodeIndex()),
+        return Float(CurrentTape().PushSingleNode(0.5f / std::sqrt(v.GetValue()), v.NodeIndex()),
                      std::sqrt(v.GetValue()));
     }
 
     // Abs of Float
     inline Float Abs(Float const &v) {
         assert(v != 0.f);
-        return Float(default_tape.PushSingleNode(Sign(v), v.NodeIndex()), std::abs(v.GetValue()));
+        return Float(CurrentTape().PushSingleNode(Sign(v), v.NodeIndex()), std::abs(v.GetValue()));
     }
 
     // Max of two Float
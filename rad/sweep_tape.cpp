@@ -0,0 +1,110 @@
+#include "sweep_tape.hpp"
+
+// Number of parents ahead whose adjoint is prefetched during the sweep
+#define SWEEP_PREFETCH_DISTANCE 16
+
+#if defined(__GNUC__)
+#define SWEEP_PREFETCH(address) __builtin_prefetch(address, 1)
+#else
+#define SWEEP_PREFETCH(address)
+#endif
+
+namespace drdemo {
+
+    SweepTape::SweepTape()
+            : base_index(0), end_index(0) {}
+
+    void SweepTape::Build(Tape const &tape, size_t end) {
+        assert(end >= tape.BaseIndex() && end <= tape.Size());
+        base_index = tape.BaseIndex();
+        end_index = end;
+        const size_t num_nodes = end - base_index;
+
+        // Count the parents of the copied nodes and the position of the streams at the end
+        size_t num_edges = 0, unary_i = 0, binary_i = 0, nary_i = 0, entry_i = 0;
+        for (size_t index = base_index; index < end; ++index) {
+            switch (tape.Kind(index)) {
+                case NodeKind::UNARY:
+                    num_edges++;
+                    unary_i++;
+                    break;
+                case NodeKind::BINARY:
+                    num_edges += 2;
+                    binary_i++;
+                    break;
+                case NodeKind::NARY:
+                    num_edges += tape.NaryCount(nary_i);
+                    entry_i += tape.NaryCount(nary_i++);
+                    break;
+                case NodeKind::LEAF:
+                    break;
+            }
+        }
+        if (num_edges > std::numeric_limits<uint32_t>::max()) {
+            std::cerr << "Tape too large to be copied for the sweep!" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        offsets.resize(num_nodes + 1);
+        weights.resize(num_edges);
+        parents.resize(num_edges);
+
+        // Walk the tape backwards and copy the parents of each node
+        size_t edge = 0;
+        for (size_t k = 0; k < num_nodes; ++k) {
+            offsets[k] = static_cast<uint32_t>(edge);
+            switch (tape.Kind(end - 1 - k)) {
+                case NodeKind::UNARY: {
+                    UnaryNode const &node = tape.Unary(--unary_i);
+                    weights[edge] = node.weight;
+                    parents[edge++] = node.parent_i;
+                    break;
+                }
+                case NodeKind::BINARY: {
+                    BinaryNode const &node = tape.Binary(--binary_i);
+                    for (int p = 0; p < 2; ++p) {
+                        weights[edge] = node.weights[p];
+                        parents[edge++] = node.parent_i[p];
+                    }
+                    break;
+                }
+                case NodeKind::NARY: {
+                    const size_t count = tape.NaryCount(--nary_i);
+                    entry_i -= count;
+                    for (size_t e = entry_i; e < entry_i + count; ++e) {
+                        UnaryNode const &entry = tape.NaryEntry(e);
+                        weights[edge] = entry.weight;
+                        parents[edge++] = entry.parent_i;
+                    }
+                    break;
+                }
+                case NodeKind::LEAF:
+                    break;
+            }
+        }
+        offsets[num_nodes] = static_cast<uint32_t>(edge);
+    }
+
+    void SweepTape::Backpropagate(std::vector<float> &adjoints) const {
+        assert(adjoints.size() >= end_index);
+        const size_t num_nodes = end_index - base_index;
+        const size_t num_edges = weights.size();
+        float *const adj = adjoints.data();
+        float const *const w = weights.data();
+        TapeIndex const *const p = parents.data();
+        uint32_t const *const offset = offsets.data();
+
+        for (size_t k = 0; k < num_nodes; ++k) {
+            const float adjoint = adj[end_index - 1 - k];
+            const uint32_t edge_end = offset[k + 1];
+            // Nodes that do not contribute to the output have no effect on their parents
+            if (adjoint == 0.f) { continue; }
+            for (uint32_t e = offset[k]; e < edge_end; ++e) {
+                // The parents are scattered in the adjoints, request the ones of the following nodes in advance
+                if (e + SWEEP_PREFETCH_DISTANCE < num_edges) { SWEEP_PREFETCH(adj + p[e + SWEEP_PREFETCH_DISTANCE]); }
+                adj[p[e]] += w[e] * adjoint;
+            }
+        }
+    }
+
+} // drdemo namespace
@@ -0,0 +1,47 @@
+#ifndef DRDEMO_SWEEP_TAPE_HPP
+#define DRDEMO_SWEEP_TAPE_HPP
+
+#include "rad.hpp"
+
+namespace drdemo {
+
+    /**
+     * Structure of arrays copy of a Tape laid out for the reverse sweep
+     *
+     * The parents of all the nodes are stored in two separate arrays, one with the weights and one with the parent
+     * indices, ordered from the last node to the first one so the sweep reads them front to back. The offsets
+     * array tells where the parents of each node start. Building the copy costs about as much as one sweep,
+     * it pays off when the same tape is swept several times, for example for several outputs
+     */
+    class SweepTape {
+    private:
+        // Index of the first node and one past the last node copied from the Tape
+        size_t base_index, end_index;
+        // Position of the parents of each node in the weights and parents arrays, in reverse node order
+        std::vector<uint32_t> offsets;
+        // Weights and parents indices of all the nodes, in reverse node order
+        std::vector<float> weights;
+        std::vector<TapeIndex> parents;
+
+    public:
+        SweepTape();
+
+        // Copy the nodes of the Tape with index in [tape.BaseIndex(), end), the memory of the arrays is reused
+        void Build(Tape const &tape, size_t end);
+
+        // Index of the first and one past the last node
+        inline size_t BaseIndex() const { return base_index; }
+
+        inline size_t EndIndex() const { return end_index; }
+
+        // Number of (weight, parent) pairs stored
+        inline size_t NumEdges() const { return weights.size(); }
+
+        // Traverse the nodes in reverse propagating the adjoints to the parents, like Derivatives::Backpropagate.
+        // The adjoints are indexed with the tape indices and must be at least EndIndex() long
+        void Backpropagate(std::vector<float> &adjoints) const;
+    };
+
+} // drdemo namespace
+
+#endif //DRDEMO_SWEEP_TAPE_HPP
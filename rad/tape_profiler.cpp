@@ -0,0 +1,149 @@
+#include <atomic>
+#include <mutex>
+#include <iomanip>
+#include "tape_profiler.hpp"
+
+namespace drdemo {
+
+    // Scope opened on a thread
+    struct ProfilerScope {
+        // Full name of the scope
+        std::string path;
+        // Tape recording when the scope was opened and its content at that point
+        Tape const *tape;
+        TapeStats start;
+        // Largest content of the Tape observed while the scope was open
+        size_t peak_nodes, peak_bytes;
+    };
+
+    // Name of the statistics recorded outside of any scope
+    static const std::string ROOT_SCOPE = "<root>";
+
+    // Profiler status and collected statistics, shared by all threads
+    static std::atomic<bool> profiler_enabled(false);
+    static std::mutex profiler_mutex;
+    static std::map<std::string, TapeStats> profiler_scopes;
+
+    // Scopes opened on each thread
+    static thread_local std::vector<ProfilerScope> open_scopes;
+
+    // Difference of the counts of two statistics, clamped to zero if the Tape was cut below the start
+    static size_t CountDifference(size_t end, size_t start) {
+        return end > start ? end - start : 0;
+    }
+
+    void TapeProfiler::Enable() {
+        profiler_enabled = true;
+    }
+
+    void TapeProfiler::Disable() {
+        profiler_enabled = false;
+    }
+
+    bool TapeProfiler::IsEnabled() {
+        return profiler_enabled.load(std::memory_order_relaxed);
+    }
+
+    void TapeProfiler::Reset() {
+        std::lock_guard<std::mutex> lock(profiler_mutex);
+        profiler_scopes.clear();
+    }
+
+    std::string TapeProfiler::CurrentScope() {
+        return open_scopes.empty() ? ROOT_SCOPE : open_scopes.back().path;
+    }
+
+    void TapeProfiler::Record(std::string const &scope, TapeStats const &stats) {
+        std::lock_guard<std::mutex> lock(profiler_mutex);
+        profiler_scopes[scope] += stats;
+    }
+
+    void TapeProfiler::Observe(size_t nodes, size_t bytes) {
+        for (ProfilerScope &scope : open_scopes) {
+            scope.peak_nodes = std::max(scope.peak_nodes, nodes);
+            scope.peak_bytes = std::max(scope.peak_bytes, bytes);
+        }
+    }
+
+    void TapeProfiler::OpenScope(std::string const &name, bool nested, Tape const &tape) {
+        std::string path = name;
+        if (nested && !open_scopes.empty()) { path = open_scopes.back().path + "/" + name; }
+        const TapeStats start = tape.Stats();
+        open_scopes.push_back({path, &tape, start, start.Nodes(), start.Bytes()});
+    }
+
+    void TapeProfiler::CloseScope() {
+        ProfilerScope const &scope = open_scopes.back();
+        const TapeStats end = scope.tape->Stats();
+        // Nodes left on the Tape by the scope, the popped ones were already recorded
+        TapeStats left;
+        left.records = 1;
+        left.leaves = CountDifference(end.leaves, scope.start.leaves);
+        left.unary = CountDifference(end.unary, scope.start.unary);
+        left.binary = CountDifference(end.binary, scope.start.binary);
+        left.nary = CountDifference(end.nary, scope.start.nary);
+        left.nary_entries = CountDifference(end.nary_entries, scope.start.nary_entries);
+        left.peak_nodes = std::max(scope.peak_nodes, end.Nodes());
+        left.peak_bytes = std::max(scope.peak_bytes, end.Bytes());
+        Record(scope.path, left);
+        open_scopes.pop_back();
+        // The enclosing scopes were open during the whole scope
+        Observe(left.peak_nodes, left.peak_bytes);
+    }
+
+    std::map<std::string, TapeStats> TapeProfiler::Scopes() {
+        std::lock_guard<std::mutex> lock(profiler_mutex);
+        return profiler_scopes;
+    }
+
+    void TapeProfiler::PrintTable(std::ostream &os) {
+        const std::map<std::string, TapeStats> scopes = Scopes();
+        size_t name_width = 5;
+        for (auto const &scope : scopes) { name_width = std::max(name_width, scope.first.size()); }
+        os << std::left << std::setw(static_cast<int>(name_width)) << "Scope" << std::right
+           << std::setw(10) << "Records" << std::setw(14) << "Nodes" << std::setw(14) << "Leaves"
+           << std::setw(14) << "Unary" << std::setw(14) << "Binary" << std::setw(14) << "N-ary"
+           << std::setw(14) << "Bytes" << std::setw(14) << "Peak nodes" << std::setw(14) << "Peak bytes"
+           << std::endl;
+        for (auto const &scope : scopes) {
+            TapeStats const &stats = scope.second;
+            os << std::left << std::setw(static_cast<int>(name_width)) << scope.first << std::right
+               << std::setw(10) << stats.records << std::setw(14) << stats.Nodes() << std::setw(14) << stats.leaves
+               << std::setw(14) << stats.unary << std::setw(14) << stats.binary << std::setw(14) << stats.nary
+               << std::setw(14) << stats.Bytes() << std::setw(14) << stats.peak_nodes << std::setw(14)
+               << stats.peak_bytes << std::endl;
+        }
+    }
+
+    void TapeProfiler::PrintJSON(std::ostream &os) {
+        const std::map<std::string, TapeStats> scopes = Scopes();
+        os << "{" << std::endl;
+        size_t i = 0;
+        for (auto const &scope : scopes) {
+            TapeStats const &stats = scope.second;
+            os << "  \"" << scope.first << "\": {"
+               << "\"records\": " << stats.records << ", "
+               << "\"nodes\": " << stats.Nodes() << ", "
+               << "\"leaves\": " << stats.leaves << ", "
+               << "\"unary\": " << stats.unary << ", "
+               << "\"binary\": " << stats.binary << ", "
+               << "\"nary\": " << stats.nary << ", "
+               << "\"nary_entries\": " << stats.nary_entries << ", "
+               << "\"bytes\": " << stats.Bytes() << ", "
+               << "\"peak_nodes\": " << stats.peak_nodes << ", "
+               << "\"peak_bytes\": " << stats.peak_bytes << "}"
+               << (++i < scopes.size() ? "," : "") << std::endl;
+        }
+        os << "}" << std::endl;
+    }
+
+    TapeProfileScope::TapeProfileScope(std::string const &name, bool nested)
+            : opened(TapeProfiler::IsEnabled()) {
+        if (opened) { TapeProfiler::OpenScope(name, nested, CurrentTape()); }
+    }
+
+    TapeProfileScope::~TapeProfileScope() {
+        if (opened) { TapeProfiler::CloseScope(); }
+    }
+
+} // drdemo namespace
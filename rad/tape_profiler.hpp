@@ -0,0 +1,79 @@
+#ifndef DRDEMO_TAPE_PROFILER_HPP
+#define DRDEMO_TAPE_PROFILER_HPP
+
+#include <map>
+#include <string>
+#include "rad.hpp"
+
+namespace drdemo {
+
+    /**
+     * Collect statistics about the Tape usage of the different parts of a computation
+     *
+     * The statistics are attributed to named scopes, opened with TapeProfileScope, nested scopes are named with
+     * the path of the enclosing ones ("iteration/image term"). Each Tape Pop records the nodes of the popped portion
+     * in the innermost scope of the calling thread and each scope records, when it is closed, the nodes it left on
+     * the Tape. The profiler is disabled by default and costs nothing but a flag check until it is enabled
+     */
+    class TapeProfiler {
+    private:
+        friend class TapeProfileScope;
+
+        // Open a scope on the calling thread recording on the given tape, name is used as full path when not nested
+        static void OpenScope(std::string const &name, bool nested, Tape const &tape);
+
+        // Close the innermost scope of the calling thread
+        static void CloseScope();
+
+    public:
+        // Enable / Disable the statistics collection
+        static void Enable();
+
+        static void Disable();
+
+        static bool IsEnabled();
+
+        // Delete the collected statistics
+        static void Reset();
+
+        // Name of the innermost scope opened on the calling thread
+        static std::string CurrentScope();
+
+        // Add the statistics of some nodes to the given scope
+        static void Record(std::string const &scope, TapeStats const &stats);
+
+        // Update the peaks of the scopes opened on the calling thread with the current content of a Tape
+        static void Observe(size_t nodes, size_t bytes);
+
+        // Collected statistics for each scope
+        static std::map<std::string, TapeStats> Scopes();
+
+        // Output collected statistics as a table or as JSON
+        static void PrintTable(std::ostream &os);
+
+        static void PrintJSON(std::ostream &os);
+    };
+
+    /**
+     * Open a named TapeProfiler scope on the calling thread for the lifetime of the object, the scope records the
+     * nodes of the current Tape. When nested is false the name is used as full path, this allows the worker threads
+     * to continue the scope of the thread that started them
+     */
+    class TapeProfileScope {
+    private:
+        // Check if the scope was opened, the profiler could be enabled after the construction
+        bool opened;
+
+    public:
+        explicit TapeProfileScope(std::string const &name, bool nested = true);
+
+        TapeProfileScope(TapeProfileScope const &other) = delete;
+
+        TapeProfileScope &operator=(TapeProfileScope const &other) = delete;
+
+        ~TapeProfileScope();
+    };
+
+} // drdemo namespace
+
+#endif //DRDEMO_TAPE_PROFILER_HPP
@@ -2,7 +2,9 @@
 // Created by simon on 12.05.17.
 //
 
+#include <algorithm>
 #include <iostream>
+#include <parallel.hpp>
 #include "simple_renderer.hpp"
 
 // Ray passes thorough the center of the pixel
@@ -16,13 +18,50 @@ namespace drdemo {
 
     void SimpleRenderer::RenderImage(Film *const film, Scene const &scene,
                                      CameraInterface const &camera) const {
+        // The film needs to reference the tape nodes of all pixels, only render in parallel if nothing is recorded
+        if (CurrentTape().IsEnabled()) {
+            RenderRows(film, scene, camera, 0, film->Height());
+        } else {
+            const Tape &parent = CurrentTape();
+            ParallelFor(0, film->Height(), [&](size_t, size_t row_start, size_t row_end) {
+                Tape tape = parent.Fork();
+                TapeScope scope(tape);
+                RenderRows(film, scene, camera, row_start, row_end);
+            });
+        }
+    }
+
+    void SimpleRenderer::RenderRows(Film *const film, Scene const &scene, CameraInterface const &camera,
+                                    size_t row_start, size_t row_end) const {
+        // Render with plain floats if nothing is recorded on the tape. The rays of consecutive rows of a column are
+        // coherent, they are traced together in packets
+        if (!CurrentTape().IsEnabled()) {
+            RayPacketf packet;
+            Spectrumf Li[RAY_PACKET_SIZE];
+            for (size_t i = 0; i < film->Width(); i++) {
+                for (size_t j = row_start; j < row_end; j += RAY_PACKET_SIZE) {
+                    packet.size = static_cast<int>(std::min(static_cast<size_t>(RAY_PACKET_SIZE), row_end - j));
+                    for (int lane = 0; lane < packet.size; lane++) {
+                        packet.Set(lane, camera.GenerateRayf(i, j + lane, s_x, s_y));
+                    }
+                    surface_integrator->IncomingRadiancePacket(packet, scene, camera, 0, Li);
+                    for (int lane = 0; lane < packet.size; lane++) {
+                        if (!film->AddSample(Li[lane], i, j + lane, s_x, s_y)) {
+                            std::cerr << "Error adding sample to film!" << std::endl;
+                        }
+                    }
+                }
+            }
+            return;
+        }
+
         // Current Ray
         Ray ray;
         // Incoming radiance
         Spectrum Li;
 
         for (size_t i = 0; i < film->Width(); i++) {
-            for (size_t j = 0; j < film->Height(); j++) {
+            for (size_t j = row_start; j < row_end; j++) {
                 // Generate ray
                 ray = camera.GenerateRay(i, j, s_x, s_y);
                 // Compute incoming radiance
@@ -12,6 +12,7 @@ namespace drdemo {
 
     /**
      * Define SimpleRenderer class, integrates one ray per pixel at the center
+     * When the tape is disabled the rows of the image are rendered in parallel
      */
     class SimpleRenderer : public RendererInterface {
     private:
@@ -22,6 +23,9 @@ namespace drdemo {
         explicit SimpleRenderer(std::shared_ptr<const SurfaceIntegratorInterace> const &s_i);
 
         void RenderImage(Film *film, Scene const &scene, CameraInterface const &camera) const override;
+
+        void RenderRows(Film *film, Scene const &scene, CameraInterface const &camera,
+                        size_t row_start, size_t row_end) const override;
     };
 
 } // dredemo namespace
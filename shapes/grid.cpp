@@ -3,12 +3,82 @@
 //
 
 #include <iofile.hpp>
+#include <sdf_file.hpp>
+#include <parallel.hpp>
+#include <algorithm>
+#include <cstddef>
 #include <fstream>
 #include "grid.hpp"
+#include "trilinear.hpp"
 
 namespace drdemo {
 
+    // Linear combination of n grid values, used for the finite differences, recorded as a single node
+    static Float GridCombination(Float const *data, int n, int const *indices, float const *weights) {
+        float value = 0.f;
+        Float const *parents[3];
+        for (int i = 0; i < n; i++) {
+            value += weights[i] * data[indices[i]].GetValue();
+            parents[i] = &data[indices[i]];
+        }
+
+        return FusedNode(value, static_cast<size_t>(n), weights, parents);
+    }
+
+    // Finite difference along an axis of the values in x, y, z order at the point v, which has coordinate c of n along
+    // the axis, same stencil as SignedDistanceGrid::DifferenceStencil
+    static float AxisDifference(float const *v, int c, int n, ptrdiff_t stride) {
+        if (c == n - 1) {
+            return BACKWARD_DIFFERENCE[0] * v[0] + BACKWARD_DIFFERENCE[1] * v[-stride] +
+                   BACKWARD_DIFFERENCE[2] * v[-2 * stride];
+        } else if (c == 0) {
+            return FORWARD_DIFFERENCE[0] * v[0] + FORWARD_DIFFERENCE[1] * v[stride] +
+                   FORWARD_DIFFERENCE[2] * v[2 * stride];
+        }
+        return CENTRAL_DIFFERENCE[0] * v[stride] + CENTRAL_DIFFERENCE[1] * v[-stride];
+    }
+
+    // Transpose of AxisDifference, sum over the differences along the axis that read the point d of their adjoint
+    // times the weight they give to the point
+    static float AxisDifferenceTranspose(float const *d, int c, int n, ptrdiff_t stride) {
+        float sum = 0.f;
+        // One sided differences of the first and last points
+        if (c <= 2) { sum += FORWARD_DIFFERENCE[c] * d[-c * stride]; }
+        if (c >= n - 3) { sum += BACKWARD_DIFFERENCE[n - 1 - c] * d[(n - 1 - c) * stride]; }
+        // Central differences of the neighbours
+        if (c >= 2) { sum += CENTRAL_DIFFERENCE[0] * d[-stride]; }
+        if (c <= n - 3) { sum += CENTRAL_DIFFERENCE[1] * d[stride]; }
+        return sum;
+    }
+
+    // Solve the discretised Eikonal equation at a point given the smallest distance of its neighbours along each axis
+    // and the squared inverse voxel size. The axes are added from the closest one while the solution is larger than
+    // their neighbour distance, the upwind Godunov scheme
+    static float EikonalUpdate(float a_x, float a_y, float a_z, Vector3f const &inv_width_sq) {
+        // Sort the neighbour distances with their weights
+        float n[3] = {a_x, a_y, a_z}, w[3] = {inv_width_sq.x, inv_width_sq.y, inv_width_sq.z};
+        if (n[1] < n[0]) { std::swap(n[0], n[1]), std::swap(w[0], w[1]); }
+        if (n[2] < n[1]) { std::swap(n[1], n[2]), std::swap(w[1], w[2]); }
+        if (n[1] < n[0]) { std::swap(n[0], n[1]), std::swap(w[0], w[1]); }
+        if (n[0] == INFINITY) { return INFINITY; }
+        // Coefficients of sum_k (u - a_k)^2 / h_k^2 = 1
+        float u = n[0] + 1.f / std::sqrt(w[0]);
+        float a = w[0], b = n[0] * w[0], c = n[0] * n[0] * w[0] - 1.f;
+        for (int k = 1; k < 3 && u > n[k]; k++) {
+            a += w[k];
+            b += n[k] * w[k];
+            c += n[k] * n[k] * w[k];
+            u = (b + std::sqrt(std::max(b * b - a * c, 0.f))) / a;
+        }
+
+        return u;
+    }
+
     void SignedDistanceGrid::PointsIndicesFromVoxel(int x, int y, int z, int *const indices) const {
+        if (layout == GridLayout::BRICKED) {
+            for (int i = 0; i < 8; i++) { indices[i] = StorageIndex(x + (i & 1), y + ((i >> 1) & 1), z + (i >> 2)); }
+            return;
+        }
         // Compute back face indices
         indices[0] = x + y * num_points[0] + z * num_points[0] * num_points[1];
         indices[1] = indices[0] + 1;
@@ -21,6 +91,26 @@ namespace drdemo {
         indices[7] = indices[6] + 1;
     }
 
+    void SignedDistanceGrid::VoxelLookup(const Vector3f &p, int *const indices, Vector3f *const t) const {
+        // Get voxel indices
+        int voxel_i[3];
+        for (int i = 0; i < 3; i++) {
+            voxel_i[i] = PosToVoxel(p, i);
+        }
+        // Get point indices for the given voxel
+        PointsIndicesFromVoxel(voxel_i[0], voxel_i[1], voxel_i[2], indices);
+
+        // Compute minimum point of voxel
+        const Vector3f voxel_min(bounds.MinPoint().x + voxel_i[0] * width.x,
+                                 bounds.MinPoint().y + voxel_i[1] * width.y,
+                                 bounds.MinPoint().z + voxel_i[2] * width.z);
+
+        // Local coordinates of the point inside the voxel
+        *t = Vector3f((p.x - voxel_min.x) * inv_width.x,
+                      (p.y - voxel_min.y) * inv_width.y,
+                      (p.z - voxel_min.z) * inv_width.z);
+    }
+
     Float SignedDistanceGrid::ValueAt(const Vector3F &p) const {
         // Convert position
         const Vector3f p_f = Tofloat(p);
@@ -31,54 +121,105 @@ namespace drdemo {
             // the normal of the grid intersected face
         }
 
-        // Get voxel indices
-        int voxel_i[3];
-        for (int i = 0; i < 3; i++) {
-            voxel_i[i] = PosToVoxel(p_f, i);
+        int indices[8];
+        Vector3f t;
+        VoxelLookup(p_f, indices, &t);
+
+        // Interpolate the eight values
+        Float const *values[8];
+        for (int i = 0; i < 8; i++) { values[i] = &data[indices[i]]; }
+
+        return TrilinearNode(values, p, t, inv_width);
+    }
+
+    float SignedDistanceGrid::ValueAt(const Vector3f &p) const {
+        // Check if we are outside the BBOX
+        if (!bounds.Inside(p)) {
+            return bounds.Distance(p) + 0.001f;
         }
-        // Get point indices for the given voxel
+
         int indices[8];
-        PointsIndicesFromVoxel(voxel_i[0], voxel_i[1], voxel_i[2], indices);
+        Vector3f t;
+        VoxelLookup(p, indices, &t);
 
-        // Compute minimum point of voxel
-        const Vector3f voxel_min(bounds.MinPoint().x + voxel_i[0] * width.x,
-                                 bounds.MinPoint().y + voxel_i[1] * width.y,
-                                 bounds.MinPoint().z + voxel_i[2] * width.z);
+        float values[8];
+        for (int i = 0; i < 8; i++) { values[i] = data[indices[i]].GetValue(); }
+
+        return Trilinear(values, t);
+    }
 
-        // Linear interpolate along x axis the eight values
-        const Float tx = (p.x - voxel_min.x) * inv_width.x;
-        const Float c01 = (1.f - tx) * data[indices[0]] + tx * data[indices[1]];
-        const Float c23 = (1.f - tx) * data[indices[2]] + tx * data[indices[3]];
-        const Float c45 = (1.f - tx) * data[indices[4]] + tx * data[indices[5]];
-        const Float c67 = (1.f - tx) * data[indices[6]] + tx * data[indices[7]];
+    Vector3F SignedDistanceGrid::CachedNormalAt(const Vector3F &p, int const *const indices,
+                                                Vector3f const &t) const {
+        const float w_x[2] = {1.f - t.x, t.x};
+        const float w_y[2] = {1.f - t.y, t.y};
+        const float w_z[2] = {1.f - t.z, t.z};
+        const float sign[2] = {-1.f, 1.f};
 
-        // Linear interpolate along the y axis
-        const Float ty = (p.y - voxel_min.y) * inv_width.y;
-        const Float c0 = (1.f - ty) * c01 + ty * c23;
-        const Float c1 = (1.f - ty) * c45 + ty * c67;
+        // Coordinates of the first vertex of the voxel
+        int x, y, z;
+        IndicesFromLinear(indices[0], x, y, z);
 
-        // Return final value interpolated along z
-        const Float tz = (p.z - voxel_min.z) * inv_width.z;
+        Float components[3];
+        for (int axis = 0; axis < 3; axis++) {
+            // At most three grid values for the finite difference of each vertex, plus the coordinates of p
+            Float const *parents[27];
+            float partials[27];
+            int parents_indices[24];
+            int n = 0;
+            float value = 0.f;
+            float d_t[3] = {0.f, 0.f, 0.f};
+            for (int i = 0; i < 8; i++) {
+                const int ix = i & 1, iy = (i >> 1) & 1, iz = i >> 2;
+                const float weight = w_x[ix] * w_y[iy] * w_z[iz];
+                const float gradient = gradients[indices[i]][axis];
+                value += weight * gradient;
+                // Derivatives with respect to the local coordinates
+                d_t[0] += sign[ix] * w_y[iy] * w_z[iz] * gradient;
+                d_t[1] += w_x[ix] * sign[iy] * w_z[iz] * gradient;
+                d_t[2] += w_x[ix] * w_y[iy] * sign[iz] * gradient;
+
+                // Scatter the weight of the vertex to the values of its finite difference, merging the values shared
+                // by the differences of more vertices
+                int stencil[3];
+                float stencil_weights[3];
+                const int m = DifferenceStencil(x + ix, y + iy, z + iz, axis, stencil, stencil_weights);
+                for (int j = 0; j < m; j++) {
+                    int k = 0;
+                    while (k < n && parents_indices[k] != stencil[j]) { k++; }
+                    if (k == n) {
+                        parents_indices[n] = stencil[j];
+                        parents[n] = &data[stencil[j]];
+                        partials[n++] = 0.f;
+                    }
+                    partials[k] += weight * stencil_weights[j];
+                }
+            }
+            Float const *const p_coords[3] = {&p.x, &p.y, &p.z};
+            for (int c = 0; c < 3; c++) {
+                partials[n] = d_t[c] * inv_width[c];
+                parents[n++] = p_coords[c];
+            }
+            components[axis] = FusedNode(value, static_cast<size_t>(n), partials, parents);
+        }
 
-        return (1.f - tz) * c0 + tz * c1;
+        return Vector3F(components[0], components[1], components[2]);
     }
 
     Vector3F SignedDistanceGrid::NormalAt(const Vector3F &p) const {
         // Convert position
         const Vector3f p_f = Tofloat(p);
-        // Get voxel indices
-        int voxel_i[3];
-        for (int i = 0; i < 3; i++) {
-            voxel_i[i] = PosToVoxel(p_f, i);
-        }
-        // Get point indices for the given voxel
         int indices[8];
-        PointsIndicesFromVoxel(voxel_i[0], voxel_i[1], voxel_i[2], indices);
+        Vector3f t;
+        VoxelLookup(p_f, indices, &t);
 
-        // Compute minimum point of voxel
-        const Vector3f voxel_min(bounds.MinPoint().x + voxel_i[0] * width.x,
-                                 bounds.MinPoint().y + voxel_i[1] * width.y,
-                                 bounds.MinPoint().z + voxel_i[2] * width.z);
+        if (normal_mode == NormalMode::TRILINEAR_GRADIENT) {
+            Float const *values[8];
+            for (int i = 0; i < 8; i++) { values[i] = &data[indices[i]]; }
+            return TrilinearGradientNode(values, p, t, inv_width);
+        }
+
+        // Read the gradients of the vertices from the cache if it matches the values
+        if (caches_valid) { return CachedNormalAt(p, indices, t); }
 
         int x, y, z;
         // Compute normal at the 8 vertices of the voxel
@@ -106,79 +247,184 @@ namespace drdemo {
         IndicesFromLinear(indices[7], x, y, z);
         const Vector3F n7 = NormalAtPoint(x, y, z);
 
-        // Interpolate normals
-        const Float tx = (p.x - voxel_min.x) * inv_width.x;
-        const Vector3F n01 = (1.f - tx) * n0 + tx * n1;
-        const Vector3F n23 = (1.f - tx) * n2 + tx * n3;
-        const Vector3F n45 = (1.f - tx) * n4 + tx * n5;
-        const Vector3F n67 = (1.f - tx) * n6 + tx * n7;
+        // Interpolate each component of the normals
+        Float const *const values_x[8] = {&n0.x, &n1.x, &n2.x, &n3.x, &n4.x, &n5.x, &n6.x, &n7.x};
+        Float const *const values_y[8] = {&n0.y, &n1.y, &n2.y, &n3.y, &n4.y, &n5.y, &n6.y, &n7.y};
+        Float const *const values_z[8] = {&n0.z, &n1.z, &n2.z, &n3.z, &n4.z, &n5.z, &n6.z, &n7.z};
 
-        // Interpolate along y
-        const Float ty = (p.y - voxel_min.y) * inv_width.y;
-        const Vector3F nf1 = (1.f - ty) * n01 + ty * n23;
-        const Vector3F nf2 = (1.f - ty) * n45 + ty * n67;
+        return Vector3F(TrilinearNode(values_x, p, t, inv_width),
+                        TrilinearNode(values_y, p, t, inv_width),
+                        TrilinearNode(values_z, p, t, inv_width));
+    }
+
+    Vector3f SignedDistanceGrid::NormalAt(const Vector3f &p) const {
+        int indices[8];
+        Vector3f t;
+        VoxelLookup(p, indices, &t);
+
+        if (normal_mode == NormalMode::TRILINEAR_GRADIENT) {
+            float values[8];
+            for (int i = 0; i < 8; i++) { values[i] = data[indices[i]].GetValue(); }
+            return TrilinearGradient(values, t, inv_width);
+        }
+
+        // Compute normal at the 8 vertices of the voxel, or read it from the cache
+        float values_x[8], values_y[8], values_z[8];
+        for (int i = 0; i < 8; i++) {
+            Vector3f n;
+            if (caches_valid) {
+                n = gradients[indices[i]];
+            } else {
+                int x, y, z;
+                IndicesFromLinear(indices[i], x, y, z);
+                n = NormalAtPointf(x, y, z);
+            }
+            values_x[i] = n.x;
+            values_y[i] = n.y;
+            values_z[i] = n.z;
+        }
 
-        // Return final value interpolated along z
-        const Float tz = (p.z - voxel_min.z) * inv_width.z;
+        return Vector3f(Trilinear(values_x, t), Trilinear(values_y, t), Trilinear(values_z, t));
+    }
 
-        return (1.f - tz) * nf1 + tz * nf2;
+    int SignedDistanceGrid::DifferenceStencil(int x, int y, int z, int axis, int *const indices,
+                                              float *const weights) const {
+        const int coords[3] = {x, y, z};
+        int offsets[3];
+        const int n = DifferenceOffsets(coords[axis], num_points[axis], inv_width[axis], offsets, weights);
+        for (int i = 0; i < n; i++) {
+            int point[3] = {x, y, z};
+            point[axis] += offsets[i];
+            indices[i] = LinearIndex(point[0], point[1], point[2]);
+        }
+        return n;
     }
 
     Vector3F SignedDistanceGrid::NormalAtPoint(int x, int y, int z /* , bool bd */) const {
-        Float dx, dy, dz;
-
-        // Compute x derivative
-        if (x == num_points[0] - 1) {
-            // Use backward second order to compute derivative
-            dx = (1.5f * data[LinearIndex(x, y, z)] - 2.f * data[LinearIndex(x - 1, y, z)] +
-                  0.5f * data[LinearIndex(x - 2, y, z)]) * inv_width.x;
-        } else if (x == 0) {
-            // Use forward second order difference
-            dx = (-1.5f * data[LinearIndex(x, y, z)] + 2.f * data[LinearIndex(x + 1, y, z)] -
-                  0.5f * data[LinearIndex(x + 2, y, z)]) * inv_width.x;
-        } else {
-            // Use central difference
-            dx = (data[LinearIndex(x + 1, y, z)] - data[LinearIndex(x - 1, y, z)]) * inv_width.x / 2.f;
-        }
-
-        // Compute y derivative
-        if (y == num_points[1] - 1) {
-            // Use backward second order to compute derivative
-            dy = (1.5f * data[LinearIndex(x, y, z)] - 2.f * data[LinearIndex(x, y - 1, z)] +
-                  0.5f * data[LinearIndex(x, y - 2, z)]) * inv_width.y;
-        } else if (y == 0) {
-            // Use forward second order difference
-            dy = (-1.5f * data[LinearIndex(x, y, z)] + 2.f * data[LinearIndex(x, y + 1, z)] -
-                  0.5f * data[LinearIndex(x, y + 2, z)]) * inv_width.y;
-        } else {
-            // Use central difference
-            dy = (data[LinearIndex(x, y + 1, z)] - data[LinearIndex(x, y - 1, z)]) * inv_width.y / 2.f;
-        }
-
-        // Compute z derivative
-        if (z == num_points[2] - 1) {
-            // Use backward second order to compute derivative
-            dz = (1.5f * data[LinearIndex(x, y, z)] - 2.f * data[LinearIndex(x, y, z - 1)] +
-                  0.5f * data[LinearIndex(x, y, z - 2)]) * inv_width.z;
-        } else if (z == 0) {
-            // Use forward second order difference
-            dz = (-1.5f * data[LinearIndex(x, y, z)] + 2.f * data[LinearIndex(x, y, z + 1)] -
-                  0.5f * data[LinearIndex(x, y, z + 2)]) * inv_width.z;
-        } else {
-            // Use central difference
-            dz = (data[LinearIndex(x, y, z + 1)] - data[LinearIndex(x, y, z - 1)]) * inv_width.z / 2.f;
+        // Compute the derivative along a given axis
+        auto derivative = [&](int axis) {
+            int indices[3];
+            float weights[3];
+            const int n = DifferenceStencil(x, y, z, axis, indices, weights);
+            return GridCombination(data, n, indices, weights);
+        };
+
+        return Vector3F(derivative(0), derivative(1), derivative(2));
+    }
+
+    Vector3f SignedDistanceGrid::NormalAtPointf(int x, int y, int z) const {
+        float derivatives[3];
+        for (int axis = 0; axis < 3; axis++) {
+            int indices[3];
+            float weights[3];
+            const int n = DifferenceStencil(x, y, z, axis, indices, weights);
+            derivatives[axis] = 0.f;
+            for (int i = 0; i < n; i++) { derivatives[axis] += weights[i] * data[indices[i]].GetValue(); }
+        }
+
+        return Vector3f(derivatives[0], derivatives[1], derivatives[2]);
+    }
+
+    float SignedDistanceGrid::NormalRegularization(float *const gradient, float scale) const {
+        const int n_x = num_points[0], n_y = num_points[1], n_z = num_points[2];
+        const ptrdiff_t strides[3] = {1, n_x, static_cast<ptrdiff_t>(n_x) * n_y};
+        const std::vector<float> values = LinearValues();
+        // Derivative of the term of each point with respect to its finite differences, 4 (|g|^2 - 1) g, one array
+        // for each axis. The energy is summed for each z slice
+        std::vector<float> adjoints[3];
+        if (gradient != nullptr) {
+            for (auto &adjoint : adjoints) { adjoint.resize(values.size()); }
+        }
+        std::vector<float> slice_energy(static_cast<size_t>(n_z), 0.f);
+
+        // Gradient at each point, the rows inside the grid are plain central differences the compiler vectorizes
+        ParallelFor(0, static_cast<size_t>(n_z), [&](size_t, size_t z_begin, size_t z_end) {
+            std::vector<float> g[3];
+            for (auto &g_axis : g) { g_axis.resize(static_cast<size_t>(n_x)); }
+            for (int z = static_cast<int>(z_begin); z < static_cast<int>(z_end); z++) {
+                float energy = 0.f;
+                for (int y = 0; y < n_y; y++) {
+                    const ptrdiff_t row = y * strides[1] + z * strides[2];
+                    float const *const v = values.data() + row;
+                    // Differences at a point next to the sides of the grid
+                    auto side_point = [&](int x) {
+                        g[0][x] = inv_width.x * AxisDifference(v + x, x, n_x, strides[0]);
+                        g[1][x] = inv_width.y * AxisDifference(v + x, y, n_y, strides[1]);
+                        g[2][x] = inv_width.z * AxisDifference(v + x, z, n_z, strides[2]);
+                    };
+                    if (y > 0 && y < n_y - 1 && z > 0 && z < n_z - 1) {
+                        for (int x = 1; x < n_x - 1; x++) {
+                            g[0][x] = 0.5f * inv_width.x * (v[x + 1] - v[x - 1]);
+                            g[1][x] = 0.5f * inv_width.y * (v[x + strides[1]] - v[x - strides[1]]);
+                            g[2][x] = 0.5f * inv_width.z * (v[x + strides[2]] - v[x - strides[2]]);
+                        }
+                        side_point(0);
+                        side_point(n_x - 1);
+                    } else {
+                        for (int x = 0; x < n_x; x++) { side_point(x); }
+                    }
+                    for (int x = 0; x < n_x; x++) {
+                        const float norm_minus_one = g[0][x] * g[0][x] + g[1][x] * g[1][x] + g[2][x] * g[2][x] - 1.f;
+                        energy += norm_minus_one * norm_minus_one;
+                        if (gradient != nullptr) {
+                            for (int axis = 0; axis < 3; axis++) {
+                                adjoints[axis][row + x] = 4.f * norm_minus_one * g[axis][x];
+                            }
+                        }
+                    }
+                }
+                slice_energy[z] = energy;
+            }
+        });
+
+        // The derivative with respect to each value gathers the adjoints of the differences reading it, so every
+        // thread only writes its own slices
+        if (gradient != nullptr) {
+            ParallelFor(0, static_cast<size_t>(n_z), [&](size_t, size_t z_begin, size_t z_end) {
+                std::vector<float> derivatives(static_cast<size_t>(n_x));
+                for (int z = static_cast<int>(z_begin); z < static_cast<int>(z_end); z++) {
+                    for (int y = 0; y < n_y; y++) {
+                        const ptrdiff_t row = y * strides[1] + z * strides[2];
+                        float const *const d_x = adjoints[0].data() + row;
+                        float const *const d_y = adjoints[1].data() + row;
+                        float const *const d_z = adjoints[2].data() + row;
+                        // Derivative at a point read by the one sided differences of the sides of the grid
+                        auto side_point = [&](int x) {
+                            derivatives[x] = inv_width.x * AxisDifferenceTranspose(d_x + x, x, n_x, strides[0]) +
+                                             inv_width.y * AxisDifferenceTranspose(d_y + x, y, n_y, strides[1]) +
+                                             inv_width.z * AxisDifferenceTranspose(d_z + x, z, n_z, strides[2]);
+                        };
+                        if (y > 2 && y < n_y - 3 && z > 2 && z < n_z - 3) {
+                            // Away from the sides only the central differences of the neighbours read the value
+                            for (int x = 3; x < n_x - 3; x++) {
+                                derivatives[x] = 0.5f * (inv_width.x * (d_x[x - 1] - d_x[x + 1]) +
+                                                         inv_width.y * (d_y[x - strides[1]] - d_y[x + strides[1]]) +
+                                                         inv_width.z * (d_z[x - strides[2]] - d_z[x + strides[2]]));
+                            }
+                            for (int x = 0; x < std::min(3, n_x); x++) { side_point(x); }
+                            for (int x = std::max(3, n_x - 3); x < n_x; x++) { side_point(x); }
+                        } else {
+                            for (int x = 0; x < n_x; x++) { side_point(x); }
+                        }
+                        for (int x = 0; x < n_x; x++) { gradient[row + x] += scale * derivatives[x]; }
+                    }
+                }
+            });
         }
 
-        return Vector3F(dx, dy, dz);
+        float energy = 0.f;
+        for (float e : slice_energy) { energy += e; }
+        return energy;
     }
 
-    SignedDistanceGrid::SignedDistanceGrid(int n_x, int n_y, int n_z, BBOX const &b)
-            : data(new Float[n_x * n_y * n_z]) {
+    SignedDistanceGrid::SignedDistanceGrid(int n_x, int n_y, int n_z, BBOX const &b, GridLayout grid_layout) {
         // Set number of points along each dimension
         num_points[0] = n_x;
         num_points[1] = n_y;
         num_points[2] = n_z;
         total_points = n_x * n_y * n_z;
+        SetLayout(grid_layout);
+        data = new Float[storage_points];
         // Set bounds
         bounds = b;
         // Compute voxel width
@@ -187,18 +433,25 @@ namespace drdemo {
             width[axis] = extent[axis] / static_cast<float>(num_points[axis] - 1);
             inv_width[axis] = (width[axis] == 0.f) ? 0.f : 1.f / width[axis];
         }
+        // The grid values are the differentiable variables of the shape
+        RegisterValues();
         // Compute minimum distance tolerance, must be smaller than cell size
         min_dist = std::min(MIN_DIST, std::min(std::min(width.x, width.y), width.z) / 2.f);
+        hit_derivatives = HitDerivatives::MARCHING;
+        intersector = GridIntersector::SPHERE_TRACING;
+        normal_mode = NormalMode::INTERPOLATED;
+        UpdateCaches();
     }
 
     SignedDistanceGrid::SignedDistanceGrid(int n_x, int n_y, int n_z, BBOX const &b,
-                                           float const *const raw_data)
-            : data(new Float[n_x * n_y * n_z]) {
+                                           float const *const raw_data, GridLayout grid_layout) {
         // Set number fo points along each dimension
         num_points[0] = n_x;
         num_points[1] = n_y;
         num_points[2] = n_z;
         total_points = n_x * n_y * n_z;
+        SetLayout(grid_layout);
+        data = new Float[storage_points];
         // Set bounds
         bounds = b;
         // Compute voxel width
@@ -208,17 +461,23 @@ namespace drdemo {
             inv_width[axis] = (width[axis] == 0.f) ? 0.f : 1.f / width[axis];
         }
         // Copy values
-        for (int i = 0; i < total_points; ++i) {
-            data[i] = raw_data[i];
-        }
+        CopyValues(raw_data);
+        // The grid values are the differentiable variables of the shape
+        RegisterValues();
         // Compute minimum distance tolerance, must be smaller than cell size
         min_dist = std::min(MIN_DIST, std::min(std::min(width.x, width.y), width.z) / 2.f);
+        hit_derivatives = HitDerivatives::MARCHING;
+        intersector = GridIntersector::SPHERE_TRACING;
+        normal_mode = NormalMode::INTERPOLATED;
+        UpdateCaches();
     }
 
-    SignedDistanceGrid::SignedDistanceGrid(const std::string &sdf_file) {
+    SignedDistanceGrid::SignedDistanceGrid(const std::string &sdf_file, GridLayout grid_layout) {
         // Start by trying to reading the file
         std::vector<std::string> sdf_file_lines;
-        if (ReadFile(sdf_file, sdf_file_lines)) {
+        if (IsBinarySDFFile(sdf_file)) {
+            LoadBinary(sdf_file, grid_layout);
+        } else if (ReadFile(sdf_file, sdf_file_lines)) {
             // No check on the format, we expect the file to be correct
             int n_x, n_y, n_z;
             // Get grid dimension from first line
@@ -230,7 +489,8 @@ namespace drdemo {
                 // Compute total number of points
                 total_points = n_x * n_y * n_z;
                 // Allocate memory for grid
-                data = new Float[total_points];
+                SetLayout(grid_layout);
+                data = new Float[storage_points];
             } else {
                 std::cerr << "Error in first line of .sdf file" << std::endl;
                 exit(EXIT_FAILURE);
@@ -263,30 +523,122 @@ namespace drdemo {
             }
 
             // Read all the data and set the values
+            std::vector<float> values(static_cast<size_t>(total_points), 0.f);
             float sdf_val;
             for (int i = 3; i < sdf_file_lines.size() - 1; ++i) {       // Minus 1 since last line is empty
                 if (sscanf(sdf_file_lines[i].c_str(), "%f", &sdf_val) == 1) {
-                    data[i - 3] = sdf_val;
+                    values[i - 3] = sdf_val;
                 } else {
                     std::cerr << "Error reading sdf value" << std::endl;
                     exit(EXIT_FAILURE);
                 }
             }
+            CopyValues(values.data());
         } else {
             std::cerr << "Error trying to open SDF file!" << std::endl;
             exit(EXIT_FAILURE);
         }
+        // The grid values are the differentiable variables of the shape
+        RegisterValues();
         // Compute minimum distance tolerance, must be smaller than cell size
         min_dist = std::min(MIN_DIST, std::min(std::min(width.x, width.y), width.z) / 2.f);
+        hit_derivatives = HitDerivatives::MARCHING;
+        intersector = GridIntersector::SPHERE_TRACING;
+        normal_mode = NormalMode::INTERPOLATED;
+        UpdateCaches();
+    }
+
+    void SignedDistanceGrid::SetLayout(GridLayout grid_layout) {
+        layout = grid_layout;
+        storage_points = total_points;
+        if (layout == GridLayout::BRICKED) {
+            for (int axis = 0; axis < 3; ++axis) {
+                num_bricks[axis] = (num_points[axis] + GRID_BRICK_SIZE - 1) >> GRID_BRICK_LOG2;
+            }
+            storage_points = (num_bricks[0] * num_bricks[1] * num_bricks[2]) << (3 * GRID_BRICK_LOG2);
+        } else {
+            for (int axis = 0; axis < 3; ++axis) { num_bricks[axis] = 0; }
+        }
+    }
+
+    void SignedDistanceGrid::CopyValues(float const *const values) {
+        if (layout == GridLayout::LINEAR) {
+            for (int i = 0; i < total_points; ++i) { data[i] = values[i]; }
+            return;
+        }
+        // Go over the padded grid, the padding points take the value of the closest grid point
+        for (int z = 0; z < num_bricks[2] * GRID_BRICK_SIZE; z++) {
+            const int c_z = std::min(z, num_points[2] - 1);
+            for (int y = 0; y < num_bricks[1] * GRID_BRICK_SIZE; y++) {
+                const int c_y = std::min(y, num_points[1] - 1);
+                for (int x = 0; x < num_bricks[0] * GRID_BRICK_SIZE; x++) {
+                    const int c_x = std::min(x, num_points[0] - 1);
+                    data[StorageIndex(x, y, z)] = values[(c_z * num_points[1] + c_y) * num_points[0] + c_x];
+                }
+            }
+        }
+    }
+
+    void SignedDistanceGrid::RegisterValues() {
+        Float::RegisterVariables(data, static_cast<size_t>(storage_points));
+        if (layout == GridLayout::LINEAR) { return; }
+        // The padding points are never read, as constants they are not part of the variables
+        for (int z = 0; z < num_bricks[2] * GRID_BRICK_SIZE; z++) {
+            for (int y = 0; y < num_bricks[1] * GRID_BRICK_SIZE; y++) {
+                for (int x = 0; x < num_bricks[0] * GRID_BRICK_SIZE; x++) {
+                    if (x >= num_points[0] || y >= num_points[1] || z >= num_points[2]) {
+                        Float &padding = data[StorageIndex(x, y, z)];
+                        padding = Float(padding.GetValue());
+                    }
+                }
+            }
+        }
+    }
+
+    std::vector<float> SignedDistanceGrid::LinearValues() const {
+        std::vector<float> values(static_cast<size_t>(total_points));
+        size_t i = 0;
+        for (int z = 0; z < num_points[2]; z++) {
+            for (int y = 0; y < num_points[1]; y++) {
+                for (int x = 0; x < num_points[0]; x++) {
+                    values[i++] = data[StorageIndex(x, y, z)].GetValue();
+                }
+            }
+        }
+
+        return values;
+    }
+
+    void SignedDistanceGrid::LoadBinary(const std::string &sdf_file, GridLayout grid_layout) {
+        // The file is mapped and the values copied as they are, no parsing needed
+        MappedSDFFile file;
+        if (!file.Open(sdf_file)) {
+            std::cerr << "Error trying to open binary SDF file!" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        SDFFileHeader const &header = file.Header();
+        for (int axis = 0; axis < 3; ++axis) {
+            num_points[axis] = header.dims[axis];
+            width[axis] = header.voxel_size[axis];
+            inv_width[axis] = (width[axis] == 0.f) ? 0.f : 1.f / width[axis];
+        }
+        total_points = num_points[0] * num_points[1] * num_points[2];
+        bounds = BBOX(Vector3f(header.bbox_min[0], header.bbox_min[1], header.bbox_min[2]),
+                      Vector3f(header.bbox_max[0], header.bbox_max[1], header.bbox_max[2]));
+        // Copy values
+        SetLayout(grid_layout);
+        data = new Float[storage_points];
+        CopyValues(file.Values());
     }
 
     SignedDistanceGrid::~SignedDistanceGrid() {
+        Float::UnregisterVariables(data);
         delete[] data;
     }
 
     void SignedDistanceGrid::Refine(int const *const new_dims) {
-        // Allocate space for new data
-        auto new_data = new Float[new_dims[0] * new_dims[1] * new_dims[2]];
+        // Space for the new values in x, y, z order, they are copied to the storage at the end
+        std::vector<float> new_values(static_cast<size_t>(new_dims[0] * new_dims[1] * new_dims[2]));
         // Compute new voxel width
         const Vector3f extent = bounds.Extent();
         Vector3f new_width, new_inv_width;
@@ -295,41 +647,158 @@ namespace drdemo {
             new_inv_width[axis] = (new_width[axis] == 0.f) ? 0.f : 1.f / new_width[axis];
         }
 
-        // Loop over new grid dimensions, compute point coordinates and use current grid to compute value
-        default_tape.Disable();
-        for (int z = 0; z < new_dims[2]; z++) {
-            for (int y = 0; y < new_dims[1]; y++) {
-                for (int x = 0; x < new_dims[0]; x++) {
-                    // Compute point coordinates
-                    // default_tape.Push();
-                    const Vector3F p = Vector3F(bounds.MinPoint().x + x * new_width.x,
-                                                bounds.MinPoint().y + y * new_width.y,
-                                                bounds.MinPoint().z + z * new_width.z);
-
-                    const float val = this->ValueAt(p).GetValue();
-                    // default_tape.Pop();
-
-                    const int index = z * new_dims[0] * new_dims[1] + y * new_dims[0] + x;
-                    // Compute value
-                    new_data[index] = val;
+        // Resample the current grid at the new points on plain floats, nothing is recorded on the tape. The slices
+        // along z are split between the threads, each one writes its own part of the new values
+        const size_t slice = static_cast<size_t>(new_dims[0]) * new_dims[1];
+        ParallelFor(0, static_cast<size_t>(new_dims[2]), [&](size_t, size_t z_begin, size_t z_end) {
+            for (size_t z = z_begin; z < z_end; z++) {
+                float *const slice_values = new_values.data() + z * slice;
+                for (int y = 0; y < new_dims[1]; y++) {
+                    for (int x = 0; x < new_dims[0]; x++) {
+                        const Vector3f p(bounds.MinPoint().x + x * new_width.x, bounds.MinPoint().y + y * new_width.y,
+                                         bounds.MinPoint().z + z * new_width.z);
+                        slice_values[y * new_dims[0] + x] = ValueAt(p);
+                    }
                 }
             }
-        }
-        default_tape.Enable();
+        });
 
-        // Set grid new values
+        // Set grid new values, they become the variables in a single contiguous block
+        Float *const old_data = data;
         for (int i = 0; i < 3; i++) { num_points[i] = new_dims[i]; }
         width = new_width;
         inv_width = new_inv_width;
         total_points = new_dims[0] * new_dims[1] * new_dims[2];
+        SetLayout(layout);
+        data = new Float[storage_points];
+        CopyValues(new_values.data());
+        RegisterValues();
         // Update min_dist value
         // Compute minimum distance tolerance, must be smaller than cell size
         min_dist = std::min(MIN_DIST, std::min(std::min(width.x, width.y), width.z) / 2.f);
 
-        // Free old memory
-        delete[] data;
-        // Set pointer to new data
-        data = new_data;
+        // Free old memory, its variables are not parameters anymore
+        Float::UnregisterVariables(old_data);
+        delete[] old_data;
+        UpdateCaches();
+    }
+
+    void SignedDistanceGrid::Redistance(float band, int max_iterations) {
+        // State of each point during the sweeps
+        enum : unsigned char { SWEPT, FIXED, OUTSIDE_BAND };
+        const int n_x = num_points[0], n_y = num_points[1], n_z = num_points[2];
+        const size_t slice = static_cast<size_t>(n_x) * n_y;
+        const size_t n = slice * n_z;
+        std::vector<float> values = LinearValues();
+        std::vector<float> distance(n, INFINITY);
+        std::vector<unsigned char> state(n, SWEPT);
+
+        // The points with a neighbour of the other sign are fixed to the distance to the crossings of the linear
+        // interpolation, combined over the axes as 1 / d^2 = sum_k 1 / d_k^2. The points outside the band are left
+        // as they are and do not propagate the distance
+        const size_t strides[3] = {1, static_cast<size_t>(n_x), slice};
+        ParallelFor(0, static_cast<size_t>(n_z), [&](size_t, size_t z_begin, size_t z_end) {
+            for (auto z = static_cast<int>(z_begin); z < static_cast<int>(z_end); z++) {
+                for (int y = 0; y < n_y; y++) {
+                    for (int x = 0; x < n_x; x++) {
+                        const int coords[3] = {x, y, z};
+                        const size_t i = z * slice + y * strides[1] + x;
+                        const float v = values[i];
+                        if (std::abs(v) >= band) {
+                            state[i] = OUTSIDE_BAND;
+                            continue;
+                        }
+                        if (v == 0.f) {
+                            distance[i] = 0.f;
+                            state[i] = FIXED;
+                            continue;
+                        }
+                        float inv_distance_sq = 0.f;
+                        for (int axis = 0; axis < 3; axis++) {
+                            float axis_distance = INFINITY;
+                            for (int side = -1; side <= 1; side += 2) {
+                                const int neighbour = coords[axis] + side;
+                                if (neighbour < 0 || neighbour >= num_points[axis]) { continue; }
+                                const float v_n = values[side < 0 ? i - strides[axis] : i + strides[axis]];
+                                if ((v_n > 0.f) != (v > 0.f)) {
+                                    axis_distance = std::min(axis_distance, width[axis] * v / (v - v_n));
+                                }
+                            }
+                            if (axis_distance != INFINITY) {
+                                inv_distance_sq += 1.f / std::max(axis_distance * axis_distance, 1e-20f);
+                            }
+                        }
+                        if (inv_distance_sq > 0.f) {
+                            distance[i] = 1.f / std::sqrt(inv_distance_sq);
+                            state[i] = FIXED;
+                        }
+                    }
+                }
+            }
+        });
+
+        // Gauss-Seidel sweep over the grid in one of the eight orderings, the bits of the ordering reverse the axes
+        const Vector3f inv_width_sq(inv_width.x * inv_width.x, inv_width.y * inv_width.y, inv_width.z * inv_width.z);
+        auto sweep = [&](int ordering, float *const dist) {
+            float max_change = 0.f;
+            const int step_x = (ordering & 1) ? -1 : 1;
+            const int step_y = (ordering & 2) ? -1 : 1;
+            const int step_z = (ordering & 4) ? -1 : 1;
+            for (int k_z = 0, z = step_z > 0 ? 0 : n_z - 1; k_z < n_z; k_z++, z += step_z) {
+                for (int k_y = 0, y = step_y > 0 ? 0 : n_y - 1; k_y < n_y; k_y++, y += step_y) {
+                    for (int k_x = 0, x = step_x > 0 ? 0 : n_x - 1; k_x < n_x; k_x++, x += step_x) {
+                        const size_t i = z * slice + y * strides[1] + x;
+                        if (state[i] != SWEPT) { continue; }
+                        // Closest neighbour along each axis, the ones outside the band keep their infinite distance
+                        const float a_x = std::min(x > 0 ? dist[i - 1] : INFINITY,
+                                                   x < n_x - 1 ? dist[i + 1] : INFINITY);
+                        const float a_y = std::min(y > 0 ? dist[i - n_x] : INFINITY,
+                                                   y < n_y - 1 ? dist[i + n_x] : INFINITY);
+                        const float a_z = std::min(z > 0 ? dist[i - slice] : INFINITY,
+                                                   z < n_z - 1 ? dist[i + slice] : INFINITY);
+                        const float u = EikonalUpdate(a_x, a_y, a_z, inv_width_sq);
+                        if (u < dist[i]) {
+                            max_change = std::max(max_change, dist[i] == INFINITY ? INFINITY : dist[i] - u);
+                            dist[i] = u;
+                        }
+                    }
+                }
+            }
+            return max_change;
+        };
+
+        // The orderings are split in two halves swept in parallel, the second one on a copy of the distances that is
+        // merged taking the smallest value. At most one copy of the grid is allocated whatever the number of threads,
+        // with one thread it is the usual sequential fast sweeping
+        const size_t num_threads = std::min(NumThreads(), static_cast<size_t>(2));
+        const float tolerance = 1e-2f * std::min(std::min(width.x, width.y), width.z);
+        std::vector<float> copy;
+        float max_changes[2];
+        for (int iteration = 0; iteration < max_iterations; iteration++) {
+            // The first thread works in place
+            if (num_threads > 1) { copy = distance; }
+            ParallelFor(0, 8, [&](size_t thread, size_t o_begin, size_t o_end) {
+                float *const dist = thread == 0 ? distance.data() : copy.data();
+                max_changes[thread] = 0.f;
+                for (size_t ordering = o_begin; ordering < o_end; ordering++) {
+                    max_changes[thread] = std::max(max_changes[thread], sweep(static_cast<int>(ordering), dist));
+                }
+            }, num_threads);
+            if (num_threads > 1) {
+                for (size_t i = 0; i < n; i++) { distance[i] = std::min(distance[i], copy[i]); }
+            }
+            if (*std::max_element(max_changes, max_changes + num_threads) <= tolerance) { break; }
+        }
+
+        // Restore the signs, the points never reached keep their value
+        for (size_t i = 0; i < n; i++) {
+            if (state[i] != OUTSIDE_BAND && distance[i] != INFINITY) {
+                values[i] = values[i] > 0.f ? distance[i] : -distance[i];
+            }
+        }
+        // The values are set without changing the variables
+        CopyValues(values.data());
+        UpdateCaches();
     }
 
     void SignedDistanceGrid::ToFile(const std::string &file_name) const {
@@ -341,66 +810,457 @@ namespace drdemo {
         outfile << bounds.MinPoint().x << " " << bounds.MinPoint().y << " " << bounds.MinPoint().z << std::endl;
         // Write size of the grid elements
         outfile << width.x << " " << width.y << " " << width.z << std::endl;
-        // Write all the sdf data
-        for (int i = 0; i < total_points; ++i) {
-            outfile << data[i].GetValue() << std::endl;
+        // Write all the sdf data, in x, y, z order whatever the layout
+        for (float value : LinearValues()) {
+            outfile << value << '\n';
         }
         // Close file
         outfile.close();
     }
 
-    bool SignedDistanceGrid::Intersect(Ray const &ray, Interaction *const interaction) const {
-        // The intersection procedure uses ray marching to check if we have an interaction with the stored surface
+    void SignedDistanceGrid::ToBinaryFile(const std::string &file_name) const {
+        SDFFileHeader header;
+        InitSDFFileHeader(&header);
+        for (int axis = 0; axis < 3; ++axis) {
+            header.dims[axis] = num_points[axis];
+            header.bbox_min[axis] = bounds.MinPoint()[axis];
+            header.bbox_max[axis] = bounds.MaxPoint()[axis];
+            header.voxel_size[axis] = width[axis];
+        }
+        const std::vector<float> values = LinearValues();
+        if (!WriteSDFFile(file_name, header, values.data())) {
+            std::cerr << "Error writing binary SDF file!" << std::endl;
+        }
+    }
+
+    void SignedDistanceGrid::UpdateSkipLevels() {
+        // Finest level, each cell covers the points of a block of voxels including the ones on its far faces
+        const int cell_size = 1 << GRID_SKIP_CELL_LOG2;
+        SkipLevel finest;
+        for (int axis = 0; axis < 3; axis++) {
+            finest.dims[axis] = std::max(1, (num_points[axis] - 1 + cell_size - 1) >> GRID_SKIP_CELL_LOG2);
+        }
+        finest.min_value.resize(static_cast<size_t>(finest.dims[0]) * finest.dims[1] * finest.dims[2]);
+        size_t cell = 0;
+        for (int c_z = 0; c_z < finest.dims[2]; c_z++) {
+            for (int c_y = 0; c_y < finest.dims[1]; c_y++) {
+                for (int c_x = 0; c_x < finest.dims[0]; c_x++, cell++) {
+                    float min_value = INFINITY;
+                    const int end_z = std::min((c_z + 1) * cell_size, num_points[2] - 1);
+                    const int end_y = std::min((c_y + 1) * cell_size, num_points[1] - 1);
+                    const int end_x = std::min((c_x + 1) * cell_size, num_points[0] - 1);
+                    for (int z = c_z * cell_size; z <= end_z; z++) {
+                        for (int y = c_y * cell_size; y <= end_y; y++) {
+                            for (int x = c_x * cell_size; x <= end_x; x++) {
+                                min_value = std::min(min_value, data[StorageIndex(x, y, z)].GetValue());
+                            }
+                        }
+                    }
+                    finest.min_value[cell] = min_value;
+                }
+            }
+        }
+        skip_levels.clear();
+        skip_levels.push_back(std::move(finest));
+
+        // Each coarser level takes the minimum of eight cells of the previous one, up to a single cell
+        while (skip_levels.back().dims[0] > 1 || skip_levels.back().dims[1] > 1 || skip_levels.back().dims[2] > 1) {
+            SkipLevel const &fine = skip_levels.back();
+            SkipLevel coarse;
+            for (int axis = 0; axis < 3; axis++) { coarse.dims[axis] = (fine.dims[axis] + 1) >> 1; }
+            coarse.min_value.assign(static_cast<size_t>(coarse.dims[0]) * coarse.dims[1] * coarse.dims[2], INFINITY);
+            size_t fine_cell = 0;
+            for (int c_z = 0; c_z < fine.dims[2]; c_z++) {
+                for (int c_y = 0; c_y < fine.dims[1]; c_y++) {
+                    for (int c_x = 0; c_x < fine.dims[0]; c_x++, fine_cell++) {
+                        float &min_value = coarse.min_value[((c_z >> 1) * coarse.dims[1] + (c_y >> 1)) *
+                                                            coarse.dims[0] + (c_x >> 1)];
+                        min_value = std::min(min_value, fine.min_value[fine_cell]);
+                    }
+                }
+            }
+            skip_levels.push_back(std::move(coarse));
+        }
+    }
+
+    void SignedDistanceGrid::UpdateGradients() {
+        // The padding points of the bricks are never read
+        gradients.assign(static_cast<size_t>(storage_points), Vector3f(0.f, 0.f, 0.f));
+        ParallelFor(0, static_cast<size_t>(num_points[2]), [&](size_t, size_t z_begin, size_t z_end) {
+            for (int z = static_cast<int>(z_begin); z < static_cast<int>(z_end); z++) {
+                for (int y = 0; y < num_points[1]; y++) {
+                    for (int x = 0; x < num_points[0]; x++) {
+                        const bool boundary = x == 0 || y == 0 || z == 0 || x == num_points[0] - 1 ||
+                                              y == num_points[1] - 1 || z == num_points[2] - 1;
+                        if (boundary) {
+                            gradients[StorageIndex(x, y, z)] = NormalAtPointf(x, y, z);
+                            continue;
+                        }
+                        // Central differences inside the grid, same as DifferenceStencil
+                        auto value = [&](int i, int j, int k) { return data[StorageIndex(i, j, k)].GetValue(); };
+                        gradients[StorageIndex(x, y, z)] =
+                                Vector3f((value(x + 1, y, z) - value(x - 1, y, z)) * 0.5f * inv_width.x,
+                                         (value(x, y + 1, z) - value(x, y - 1, z)) * 0.5f * inv_width.y,
+                                         (value(x, y, z + 1) - value(x, y, z - 1)) * 0.5f * inv_width.z);
+                    }
+                }
+            }
+        });
+    }
+
+    void SignedDistanceGrid::UpdateCaches() {
+        UpdateSkipLevels();
+        UpdateGradients();
+        caches_valid = true;
+    }
+
+    float SignedDistanceGrid::SkipCellExit(Vector3f const &o, Vector3f const &d, float t) const {
+        if (!caches_valid) { return 0.f; }
+        // Position of the point in voxels, only the points between the grid points can be skipped
+        const Vector3f p = o + t * d;
+        int voxel[3];
+        for (int axis = 0; axis < 3; axis++) {
+            const float coord = (p[axis] - bounds.MinPoint()[axis]) * inv_width[axis];
+            if (!(coord >= 0.f && coord < static_cast<float>(num_points[axis] - 1))) { return 0.f; }
+            voxel[axis] = static_cast<int>(coord);
+        }
 
-        // Current depth
-        Float depth(0.f);
+        // Climb the pyramid while the cell containing the point is far from the surface. The trilinear interpolation
+        // inside a cell is never smaller than the minimum of its points, so no hit can be found inside the cell
+        int level = -1;
+        for (int l = 0; l < static_cast<int>(skip_levels.size()); l++) {
+            SkipLevel const &skip_level = skip_levels[l];
+            const int shift = GRID_SKIP_CELL_LOG2 + l;
+            const size_t cell = ((voxel[2] >> shift) * static_cast<size_t>(skip_level.dims[1]) + (voxel[1] >> shift)) *
+                                skip_level.dims[0] + (voxel[0] >> shift);
+            if (skip_level.min_value[cell] <= min_dist) { break; }
+            level = l;
+        }
+        if (level < 0) { return 0.f; }
+
+        // Parameter at which the ray leaves the cell, the cell is clipped to the grid points
+        const int shift = GRID_SKIP_CELL_LOG2 + level;
+        float t_exit = INFINITY;
+        for (int axis = 0; axis < 3; axis++) {
+            if (d[axis] == 0.f) { continue; }
+            const int cell_min = (voxel[axis] >> shift) << shift;
+            const int face = d[axis] > 0.f ? std::min(cell_min + (1 << shift), num_points[axis] - 1) : cell_min;
+            const float boundary = bounds.MinPoint()[axis] + face * width[axis];
+            t_exit = std::min(t_exit, (boundary - p[axis]) / d[axis]);
+        }
+        // Move slightly past the face so the next point is in the following cell
+        return std::max(t_exit, 0.f) + 0.01f * min_dist;
+    }
+
+    float SignedDistanceGrid::SkipDistance(Vector3f const &o, Vector3f const &d, float t) const {
+        // Take the sphere tracing step if longer. The value is not recorded on the tape, the skipped space does not
+        // contribute to the derivatives
+        const float skip = SkipCellExit(o, d, t);
+        return skip > 0.f ? std::max(skip, ValueAt(o + t * d)) : 0.f;
+    }
+
+    template<typename T>
+    void SignedDistanceGrid::FillInteraction(TRay<T> const &ray, T const &depth,
+                                             TInteraction<T> *const interaction) const {
+        FillGridInteraction(ray, depth, [this](Vector3<T> const &p) { return NormalAt(p); }, interaction);
+    }
+
+    template<typename T>
+    bool SignedDistanceGrid::SphereTrace(TRay<T> const &ray, TInteraction<T> *const interaction) const {
+        // The intersection procedure uses ray marching to check if we have an interaction with the stored surface,
+        // the cells far from the surface are jumped over without looking at the grid values
+        const Vector3f o = Tofloat(ray.o), d = Tofloat(ray.d);
+        T depth;
+        if (!SphereTraceDepth(ray, bounds, min_dist, [this](Vector3<T> const &p) { return ValueAt(p); },
+                              [&](float t) { return SkipDistance(o, d, t); }, &depth)) {
+            return false;
+        }
+        FillInteraction(ray, depth, interaction);
+        return true;
+    }
+
+    template<typename T>
+    bool SignedDistanceGrid::SphereTraceP(TRay<T> const &ray) const {
+        // The intersection procedure uses ray marching to check if we have a hit with the surface
+        const Vector3f o = Tofloat(ray.o), d = Tofloat(ray.d);
+        T depth;
+        return SphereTraceDepth(ray, bounds, min_dist, [this](Vector3<T> const &p) { return ValueAt(p); },
+                                [&](float t) { return SkipDistance(o, d, t); }, &depth);
+    }
+
+    void SignedDistanceGrid::PacketValueAt(float const (*const p)[RAY_PACKET_SIZE], bool const *const mask,
+                                           float *const values) const {
+        // Voxel and local coordinates of all the lanes, same operations as VoxelLookup
+        int voxel[3][RAY_PACKET_SIZE];
+        float t[3][RAY_PACKET_SIZE];
+        for (int axis = 0; axis < 3; axis++) {
+            const float min_point = bounds.MinPoint()[axis];
+            const int max_voxel = num_points[axis] - 2;
+            for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+                const auto v_i = static_cast<int>((p[axis][lane] - min_point) * inv_width[axis]);
+                voxel[axis][lane] = std::min(std::max(v_i, 0), max_voxel);
+                t[axis][lane] = (p[axis][lane] - (min_point + voxel[axis][lane] * width[axis])) * inv_width[axis];
+            }
+        }
+
+        // Gather the values at the vertices of the voxels, the lanes outside the grid use the distance to the bounds
+        float vertices[8][RAY_PACKET_SIZE];
+        bool inside[RAY_PACKET_SIZE];
+        for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+            const Vector3f point(p[0][lane], p[1][lane], p[2][lane]);
+            inside[lane] = mask[lane] && bounds.Inside(point);
+            if (!inside[lane]) {
+                for (auto &vertex : vertices) { vertex[lane] = 0.f; }
+                if (mask[lane]) { values[lane] = bounds.Distance(point) + 0.001f; }
+                continue;
+            }
+            int indices[8];
+            PointsIndicesFromVoxel(voxel[0][lane], voxel[1][lane], voxel[2][lane], indices);
+            for (int i = 0; i < 8; i++) { vertices[i][lane] = data[indices[i]].GetValue(); }
+        }
+
+        // Trilinear interpolation of all the lanes, same operations as Trilinear
+        float interpolated[RAY_PACKET_SIZE];
+        for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+            const float t_x = t[0][lane], t_y = t[1][lane], t_z = t[2][lane];
+            const float c01 = (1.f - t_x) * vertices[0][lane] + t_x * vertices[1][lane];
+            const float c23 = (1.f - t_x) * vertices[2][lane] + t_x * vertices[3][lane];
+            const float c45 = (1.f - t_x) * vertices[4][lane] + t_x * vertices[5][lane];
+            const float c67 = (1.f - t_x) * vertices[6][lane] + t_x * vertices[7][lane];
+            const float c0 = (1.f - t_y) * c01 + t_y * c23;
+            const float c1 = (1.f - t_y) * c45 + t_y * c67;
+            interpolated[lane] = (1.f - t_z) * c0 + t_z * c1;
+        }
+        for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+            if (inside[lane]) { values[lane] = interpolated[lane]; }
+        }
+    }
+
+    void SignedDistanceGrid::SphereTracePacket(RayPacketf const &packet, bool *const hits, float *const t_hit) const {
+        // Current depth and end of each ray, the lanes stay active until they hit the surface or leave the grid
+        float depth[RAY_PACKET_SIZE], t_exit[RAY_PACKET_SIZE];
+        bool active[RAY_PACKET_SIZE];
+        int num_active = 0;
+        for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+            active[lane] = false;
+            depth[lane] = t_exit[lane] = 0.f;
+            if (lane >= packet.size) { continue; }
+            hits[lane] = false;
+            // Clip the ray to the grid bounds, outside them there is no surface
+            float t_enter;
+            if (bounds.Intersect(packet.Get(lane), &t_enter, &t_exit[lane])) {
+                t_exit[lane] = std::min(t_exit[lane], MAX_DIST);
+                depth[lane] = t_enter;
+                active[lane] = true;
+                num_active++;
+            }
+        }
 
-        for (int steps = 0; steps < MAX_STEPS; steps++) {
-            // Compute distance from surface
-            const Float distance = ValueAt(ray(depth));
-            // Check if we are close enough to the surface
-            if (distance < min_dist) {
-                // Fill interaction
-                interaction->p = ray(depth);
+        float p[3][RAY_PACKET_SIZE], distance[RAY_PACKET_SIZE], skip[RAY_PACKET_SIZE];
+        for (int steps = 0; steps < MAX_STEPS && num_active > 0; steps++) {
+            // Exit of the empty cells containing the current points, the pyramid lookups differ between the lanes
+            for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+                if (!active[lane]) { continue; }
+                const Vector3f o(packet.o[0][lane], packet.o[1][lane], packet.o[2][lane]);
+                const Vector3f d(packet.d[0][lane], packet.d[1][lane], packet.d[2][lane]);
+                skip[lane] = SkipCellExit(o, d, depth[lane]);
+            }
 
-                // Estimate normal
-                interaction->n = Normalize(NormalAt(interaction->p));
+            // Sample the grid at the current points together, the inactive lanes read a grid point
+            for (int axis = 0; axis < 3; axis++) {
+                for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+                    p[axis][lane] = active[lane] ? packet.o[axis][lane] + depth[lane] * packet.d[axis][lane]
+                                                 : bounds.MinPoint()[axis];
+                }
+            }
+            PacketValueAt(p, active, distance);
+
+            // Same steps as SphereTrace with SkipDistance. The lanes close enough to the surface or out of the grid
+            // stop, the other ones step forward
+            for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+                if (!active[lane]) { continue; }
+                if (skip[lane] > 0.f) {
+                    depth[lane] += std::max(skip[lane], distance[lane]);
+                } else if (distance[lane] < min_dist) {
+                    hits[lane] = true;
+                    t_hit[lane] = depth[lane];
+                    active[lane] = false;
+                    num_active--;
+                    continue;
+                } else {
+                    depth[lane] += distance[lane];
+                }
+                if (depth[lane] > t_exit[lane]) {
+                    active[lane] = false;
+                    num_active--;
+                }
+            }
+        }
+    }
 
-                // Interaction parameter
-                interaction->t = depth;
+    bool SignedDistanceGrid::TraverseCells(Rayf const &ray, float *const t_hit) const {
+        // Clip the ray to the grid bounds, outside them there is no surface
+        float t_enter, t_exit;
+        if (!bounds.Intersect(ray, &t_enter, &t_exit)) { return false; }
+        t_exit = std::min(t_exit, MAX_DIST);
+
+        // Setup the 3D DDA from the voxel containing the point at parameter t
+        int voxel[3], step[3];
+        float t_next[3], t_delta[3];
+        auto start_at = [&](float t) {
+            const Vector3f p = ray(t);
+            for (int axis = 0; axis < 3; ++axis) {
+                voxel[axis] = PosToVoxel(p, axis);
+                const float voxel_min = bounds.MinPoint()[axis] + voxel[axis] * width[axis];
+                if (ray.d[axis] > 0.f) {
+                    step[axis] = 1;
+                    t_next[axis] = (voxel_min + width[axis] - ray.o[axis]) / ray.d[axis];
+                    t_delta[axis] = width[axis] / ray.d[axis];
+                } else if (ray.d[axis] < 0.f) {
+                    step[axis] = -1;
+                    t_next[axis] = (voxel_min - ray.o[axis]) / ray.d[axis];
+                    t_delta[axis] = -width[axis] / ray.d[axis];
+                } else {
+                    step[axis] = 0;
+                    t_next[axis] = INFINITY;
+                    t_delta[axis] = INFINITY;
+                }
+            }
+        };
+        start_at(t_enter);
 
-                // Outgoing direction
-                interaction->wo = -Normalize(ray.d);
-                // Set albedo to 1
-                interaction->albedo = Spectrum(1.f); // FIXME Hardcoded for the moment
+        float t_in = t_enter;
+        int indices[8];
+        float values[8];
+        while (true) {
+            // Axis of the face through which the ray leaves the voxel
+            const int axis = t_next[0] < t_next[1] ? (t_next[0] < t_next[2] ? 0 : 2) : (t_next[1] < t_next[2] ? 1 : 2);
+            const float t_out = std::min(t_next[axis], t_exit);
+
+            // A voxel can contain the surface only if its vertices do not all have the same sign
+            PointsIndicesFromVoxel(voxel[0], voxel[1], voxel[2], indices);
+            float min_value = INFINITY, max_value = -INFINITY;
+            for (int i = 0; i < 8; i++) {
+                values[i] = data[indices[i]].GetValue();
+                min_value = std::min(min_value, values[i]);
+                max_value = std::max(max_value, values[i]);
+            }
+            if (min_value <= 0.f && (max_value >= 0.f || t_in == t_enter)) {
+                // Segment of the ray inside the voxel in local coordinates
+                const Vector3f voxel_min(bounds.MinPoint().x + voxel[0] * width.x,
+                                         bounds.MinPoint().y + voxel[1] * width.y,
+                                         bounds.MinPoint().z + voxel[2] * width.z);
+                const Vector3f start = ray(t_in) - voxel_min;
+                const float length = t_out - t_in;
+                const Vector3f a(start.x * inv_width.x, start.y * inv_width.y, start.z * inv_width.z);
+                const Vector3f b(ray.d.x * inv_width.x * length, ray.d.y * inv_width.y * length,
+                                 ray.d.z * inv_width.z * length);
+                float u;
+                if (TrilinearSegmentRoot(values, a, b, &u)) {
+                    *t_hit = t_in + u * (t_out - t_in);
+                    return true;
+                }
+            }
 
-                return true;
+            // Jump over the empty space skipping cell containing the voxel if its points are all far from the surface
+            if (min_value > min_dist) {
+                const float t_middle = 0.5f * (t_in + t_out);
+                const float skip = SkipCellExit(ray.o, ray.d, t_middle);
+                if (skip > 0.f) {
+                    // The step ends just past the face of the cell, the next voxel starts on the face
+                    const float t_cell = t_middle + skip;
+                    if (t_cell >= t_exit) { return false; }
+                    start_at(t_cell);
+                    t_in = t_cell - 0.01f * min_dist;
+                    continue;
+                }
             }
-            // Increase distance
-            depth += distance;
-            // Check for end
-            if (depth > MAX_DIST) { return false; }
+
+            // Move to the next voxel
+            if (t_next[axis] >= t_exit) { return false; }
+            voxel[axis] += step[axis];
+            if (voxel[axis] < 0 || voxel[axis] > num_points[axis] - 2) { return false; }
+            t_in = t_next[axis];
+            t_next[axis] += t_delta[axis];
+        }
+    }
+
+    void SignedDistanceGrid::ImplicitHit(Ray const &ray, float t, Interaction *const interaction) const {
+        // The hit parameter t solves phi(o + t * d) = 0. Moving the values of the grid or the ray changes it by
+        // dt = -dphi / (grad(phi) . d), where dphi is the change of the distance at the hit point. Record only the
+        // distance at the hit and give the parameter that derivative, its value stays the one found passively
+        Float depth(t);
+        const Rayf ray_f = Tofloat(ray);
+        const float grad_dot_d = Dot(NormalAt(ray_f(t)), ray_f.d);
+        // At grazing angles the hit moves along the ray without bound, keep it fixed
+        if (std::abs(grad_dot_d) > EPS) {
+            const Float distance = ValueAt(ray(t));
+            const float partial = -1.f / grad_dot_d;
+            Float const *const parent = &distance;
+            depth = FusedNode(t, 1, &partial, &parent);
+        }
+        FillInteraction(ray, depth, interaction);
+    }
+
+    bool SignedDistanceGrid::Intersect(Ray const &ray, Interaction *const interaction) const {
+        if (intersector == GridIntersector::DDA) {
+            float t;
+            if (!TraverseCells(Tofloat(ray), &t)) { return false; }
+            ImplicitHit(ray, t, interaction);
+            return true;
         }
-        return false;
+        if (hit_derivatives == HitDerivatives::IMPLICIT) {
+            // March on plain floats, nothing is recorded on the tape
+            Interactionf hit;
+            if (!SphereTrace(Tofloat(ray), &hit)) { return false; }
+            ImplicitHit(ray, hit.t, interaction);
+            return true;
+        }
+        return SphereTrace(ray, interaction);
     }
 
     bool SignedDistanceGrid::IntersectP(Ray const &ray) const {
-        // The intersection procedure uses ray marching to check if we have a hit with the surface
+        if (intersector == GridIntersector::DDA) {
+            float t;
+            return TraverseCells(Tofloat(ray), &t);
+        }
+        // The visibility has no derivatives, with implicit hits there is no need to record it
+        if (hit_derivatives == HitDerivatives::IMPLICIT) { return SphereTraceP(Tofloat(ray)); }
+        return SphereTraceP(ray);
+    }
+
+    bool SignedDistanceGrid::Intersect(Rayf const &ray, Interactionf *const interaction) const {
+        if (intersector == GridIntersector::DDA) {
+            float t;
+            if (!TraverseCells(ray, &t)) { return false; }
+            FillInteraction(ray, t, interaction);
+            return true;
+        }
+        return SphereTrace(ray, interaction);
+    }
 
-        // Current depth
-        Float depth(0.f);
+    bool SignedDistanceGrid::IntersectP(Rayf const &ray) const {
+        if (intersector == GridIntersector::DDA) {
+            float t;
+            return TraverseCells(ray, &t);
+        }
+        return SphereTraceP(ray);
+    }
 
-        for (int steps = 0; steps < MAX_STEPS; steps++) {
-            // Compute distance from surface
-            const Float distance = ValueAt(ray(depth));
-            // Check if we are close enough to the surface
-            if (distance < min_dist) { return true; }
-            // Increase distance
-            depth += distance;
-            // Check for end
-            if (depth > MAX_DIST) { return false; }
+    void SignedDistanceGrid::IntersectPacket(RayPacketf const &packet, Interactionf *const interactions,
+                                             bool *const hits) const {
+        // The DDA walks different voxels for each ray, the rays are traced one by one
+        if (intersector == GridIntersector::DDA) {
+            Shape::IntersectPacket(packet, interactions, hits);
+            return;
+        }
+        float t_hit[RAY_PACKET_SIZE];
+        SphereTracePacket(packet, hits, t_hit);
+        for (int lane = 0; lane < packet.size; lane++) {
+            if (!hits[lane]) { continue; }
+            FillInteraction(packet.Get(lane), t_hit[lane], &interactions[lane]);
+            packet.t_max[lane] = t_hit[lane];
         }
-        return false;
     }
 
     BBOX SignedDistanceGrid::BBox() const {
@@ -412,9 +1272,10 @@ namespace drdemo {
     }
 
     std::string SignedDistanceGrid::ToString() const {
+        const std::vector<float> values = LinearValues();
         std::string content("(");
         for (int i = 0; i < total_points; i++) {
-            content += std::to_string(data[i].GetValue());
+            content += std::to_string(values[i]);
             if (i != total_points - 1) {
                 content += ", ";
             }
@@ -425,8 +1286,13 @@ namespace drdemo {
     }
 
     void SignedDistanceGrid::GetDiffVariables(std::vector<Float const *> &vars) const {
-        for (int i = 0; i < total_points; ++i) {
-            vars.push_back(&data[i]);
+        // The grid points in x, y, z order, the padding of the bricks is left out
+        for (int z = 0; z < num_points[2]; z++) {
+            for (int y = 0; y < num_points[1]; y++) {
+                for (int x = 0; x < num_points[0]; x++) {
+                    vars.push_back(&data[StorageIndex(x, y, z)]);
+                }
+            }
         }
     }
 
@@ -446,136 +1312,30 @@ namespace drdemo {
     void SignedDistanceGrid::UpdateDiffVariables(const std::vector<float> &delta, size_t starting_index) {
         // Second attempt, trying to correct the SDF after propagating directly the gradient into it
 
-        // Propagate gradient inside the grid
+        // Propagate gradient inside the grid, in the order of GetDiffVariables
         size_t used_vars = 0;
-        for (int i = 0; i < total_points; ++i) {
-            data[i].SetValue(data[i].GetValue() + delta[starting_index + used_vars++]);
+        for (int z = 0; z < num_points[2]; z++) {
+            for (int y = 0; y < num_points[1]; y++) {
+                for (int x = 0; x < num_points[0]; x++) {
+                    Float &value = data[StorageIndex(x, y, z)];
+                    value.SetValue(value.GetValue() + delta[starting_index + used_vars++]);
+                }
+            }
         }
-        // Reinitialise the grid to be a SDF after gradient update
-        // ReinitializeSDF(*this, 0.0001f, 10000, 0.005f, 100.f);
+        // The values drift away from a signed distance field, Redistance can bring them back between iterations
+        UpdateCaches();
     }
 
     void SignedDistanceGrid::SetDiffVariables(const std::vector<float> &vals, size_t starting_index) {
         size_t used_vars = 0;
-        for (int i = 0; i < total_points; ++i) {
-            data[i].SetValue(vals[starting_index + used_vars++]);
+        for (int z = 0; z < num_points[2]; z++) {
+            for (int y = 0; y < num_points[1]; y++) {
+                for (int x = 0; x < num_points[0]; x++) {
+                    data[StorageIndex(x, y, z)].SetValue(vals[starting_index + used_vars++]);
+                }
+            }
         }
+        UpdateCaches();
     }
-//
-//    float GradNorm2(const SignedDistanceGrid &grid, int x, int y, int z) {
-//        // Compute derivatives using finite difference
-//        const float grad_x = (grid(x + 1, y, z).GetValue() - grid(x, y, z).GetValue()) * grid.InvVoxelSize().x;
-//        const float grad_y = (grid(x, y + 1, z).GetValue() - grid(x, y, z).GetValue()) * grid.InvVoxelSize().y;
-//        const float grad_z = (grid(x, y, z + 1).GetValue() - grid(x, y, z).GetValue()) * grid.InvVoxelSize().z;
-//
-//        return grad_x * grad_x + grad_y * grad_y + grad_z * grad_z;
-//    }
-//
-//    void ComputeSignGrid(const SignedDistanceGrid &grid, float *sign_grid) {
-//        for (int z = 0; z < grid.Size(2); z++) {
-//            for (int y = 0; y < grid.Size(1); y++) {
-//                for (int x = 0; x < grid.Size(0); x++) {
-//                    // Get SDF value
-//                    const float sdf_v = grid(x, y, z).GetValue();
-//                    // Compute gradient squared norm
-//                    const float grad_2 = GradNorm2(grid, x, y, z);
-//                    // Update sign
-//                    sign_grid[grid.LinearIndex(x, y, z)] = sdf_v /
-//                                                           std::sqrt(sdf_v * sdf_v + grad_2 * EPS * EPS);
-//                }
-//            }
-//        }
-//    }
-//
-//    float RightTermReinitializePDE(const SignedDistanceGrid &grid, const float *sign_grid, int x, int y, int z) {
-//        // Compute gradient norm term using Godunov method
-//        const float dphi_dx_plus = (grid(x + 1, y, z).GetValue() - grid(x, y, z).GetValue()) * grid.InvVoxelSize().x;
-//        const float dphi_dx_minus = (grid(x, y, z).GetValue() - grid(x - 1, y, z).GetValue()) * grid.InvVoxelSize().x;
-//
-//        const float dphi_dy_plus = (grid(x, y + 1, z).GetValue() - grid(x, y, z).GetValue()) * grid.InvVoxelSize().y;
-//        const float dphi_dy_minus = (grid(x, y, z).GetValue() - grid(x, y - 1, z).GetValue()) * grid.InvVoxelSize().y;
-//
-//        const float dphi_dz_plus = (grid(x, y, z + 1).GetValue() - grid(x, y, z).GetValue()) * grid.InvVoxelSize().z;
-//        const float dphi_dz_minus = (grid(x, y, z).GetValue() - grid(x, y, z - 1).GetValue()) * grid.InvVoxelSize().z;
-//
-//        // Check sign and compute gradient norm
-//        float grad_x_sq, grad_y_sq, grad_z_sq;
-//
-//        if (sign_grid[grid.LinearIndex(x, y, z)] > 0.f) {
-//            grad_x_sq = std::max(PositiveSQ(dphi_dx_minus), NegativeSQ(dphi_dx_plus));
-//            grad_y_sq = std::max(PositiveSQ(dphi_dy_minus), NegativeSQ(dphi_dy_plus));
-//            grad_z_sq = std::max(PositiveSQ(dphi_dz_minus), NegativeSQ(dphi_dz_plus));
-//        } else {
-//            grad_x_sq = std::max(PositiveSQ(dphi_dx_plus), NegativeSQ(dphi_dx_minus));
-//            grad_y_sq = std::max(PositiveSQ(dphi_dy_plus), NegativeSQ(dphi_dy_minus));
-//            grad_z_sq = std::max(PositiveSQ(dphi_dz_plus), NegativeSQ(dphi_dz_minus));
-//        }
-//
-//        const float grad_norm = std::sqrt(grad_x_sq + grad_y_sq + grad_z_sq);
-//
-//        return sign_grid[grid.LinearIndex(x, y, z)] * (1.f - grad_norm);
-//    }
-//
-//    void ReinitializeSDF(SignedDistanceGrid &grid, float dt, size_t max_iters, float tolerance, float band) {
-//        std::cout << "Reinitializing SDF..." << std::endl;
-//        // Allocate space for storing the sign grid
-//        auto sign_grid = new float[grid.GetNumVars()];
-//
-//        // Compute initial sign grid
-//        ComputeSignGrid(grid, sign_grid);
-//
-//        // Allocate space to store dphi_dt
-//        auto sdf_dt = new float[grid.GetNumVars()];
-//        float max_dt = tolerance + 1.f;
-//        size_t iters = 0;
-//
-//        // Construction loop
-//        while (iters < max_iters && max_dt > tolerance) {
-//            max_dt = 0.f;
-//
-//            // Loop over all grid and compute the right term of our PDE
-//            for (int z = 0; z < grid.Size(2); z++) {
-//                for (int y = 0; y < grid.Size(1); y++) {
-//                    for (int x = 0; x < grid.Size(0); x++) {
-//                        const int linear_index = grid.LinearIndex(x, y, z);
-//                        // Check if value is inside the band
-//                        if (std::abs(grid(x, y, z).GetValue()) >= band) {
-//                            sdf_dt[linear_index] = 0.f;
-//                        } else {
-//                            // Compute right part of PDE
-//                            sdf_dt[linear_index] = RightTermReinitializePDE(grid, sign_grid, x, y, z);
-//                            // Check for new max_dt
-//                            if (std::abs(sdf_dt[linear_index]) > max_dt) {
-//                                max_dt = std::abs(sdf_dt[linear_index]);
-//                            }
-//                        }
-//                    }
-//                }
-//            }
-//
-//            // Update our SDF
-//            for (int z = 0; z < grid.Size(2); z++) {
-//                for (int y = 0; y < grid.Size(1); y++) {
-//                    for (int x = 0; x < grid.Size(0); x++) {
-//                        grid(x, y, z).SetValue(grid(x, y, z).GetValue() + dt * sdf_dt[grid.LinearIndex(x, y, z)]);
-//                    }
-//                }
-//            }
-//
-//            // Update sign grid
-//            ComputeSignGrid(grid, sign_grid);
-////            if (iters != 0 && iters % 100 == 0) {
-////                std::cout << iters << " iterations..." << std::endl;
-////            }
-//            iters++;
-//        }
-//
-//        std::cout << "Reinitialised SDF in " << iters << " iterations." << std::endl;
-//        std::cout << "Max dphi_dt: " << max_dt << std::endl;
-//
-//        // Free sign grid and sdf_dt
-//        delete[] sign_grid;
-//        delete[] sdf_dt;
-//    }
 
 } // drdemo namespace
@@ -10,18 +10,83 @@
 
 namespace drdemo {
 
+    // Number of points of a storage brick along each axis, must be a power of two
+    const int GRID_BRICK_LOG2 = 2;
+    const int GRID_BRICK_SIZE = 1 << GRID_BRICK_LOG2;
+
+    // Number of voxels along each axis of the finest empty space skipping cells, as a power of two
+    const int GRID_SKIP_CELL_LOG2 = 2;
+
+    // Maximum number of rounds of the eight fast sweeping orderings done by SignedDistanceGrid::Redistance
+    const int REDISTANCE_MAX_ITERATIONS = 8;
+
+    // Storage order of the values of a SignedDistanceGrid
+    enum class GridLayout {
+        // Along x, y, z
+        LINEAR,
+        // In bricks of GRID_BRICK_SIZE^3 points, the bricks and the points inside them along x, y, z. The eight
+        // vertices of a voxel are mostly in the same brick, so lookups touch less cache lines on large grids
+        BRICKED
+    };
+
+    // How the derivatives of the ray hits with a SignedDistanceGrid are computed
+    enum class HitDerivatives {
+        // Every sphere tracing step is recorded on the tape
+        MARCHING,
+        // The marching is passive and only the hit is recorded. The derivative of the ray parameter comes from the
+        // implicit function theorem, dt = -dphi / (grad(phi) . d), so the tape of a pixel holds a single ValueAt
+        // and NormalAt instead of one ValueAt per step
+        IMPLICIT
+    };
+
+    // How the normals of a SignedDistanceGrid are computed
+    enum class NormalMode {
+        // Trilinear interpolation of the finite differences gradients at the eight vertices of the voxel, smooth
+        // across the faces of the voxels
+        INTERPOLATED,
+        // Analytic gradient of the trilinear interpolation inside the voxel, from the same eight values used by
+        // ValueAt. Much cheaper to compute and record, but only continuous inside each voxel
+        TRILINEAR_GRADIENT
+    };
+
+    // Algorithm used to intersect rays with a SignedDistanceGrid
+    enum class GridIntersector {
+        // Sphere tracing, the hit is the first point closer to the surface than the minimum distance
+        SPHERE_TRACING,
+        // 3D DDA over the voxels, the trilinear interpolation along the ray is solved analytically in the voxels
+        // whose vertices change sign. The hit is exact and the voxels visited are bounded by the size of the grid.
+        // The derivatives of the hits are always computed as with HitDerivatives::IMPLICIT
+        DDA
+    };
+
     /**
      * This file defines an implementation of a signed distance filed mesh representation using a 3D grid
      * We store the value of the signed distance function at each vertex
      *
-     * The storage order is along x, y, z.
+     * The storage order is along x, y, z, or in bricks with GridLayout::BRICKED. With bricks the dimensions are
+     * padded to a multiple of GRID_BRICK_SIZE, the padding points repeat the closest grid point. LinearIndex gives the
+     * position of a point in the storage. The differentiable variables are the grid points in x, y, z order whatever
+     * the layout, the padding points are never read and stay constants
+     *
+     * Sphere tracing skips the space far from the surface with a pyramid of the minimum value over blocks of voxels,
+     * and the normals interpolate a cache of the gradient at each point, see UpdateCaches
      */
     class SignedDistanceGrid : public Shape, public DiffObjectInterface {
     private:
+        // Level of the empty space skipping pyramid, minimum value over the points of each cell in x, y, z order
+        struct SkipLevel {
+            int dims[3];
+            std::vector<float> min_value;
+        };
+
         // Number of points for each axis (number of voxels is the value for a given axis minus 1)
         int num_points[3];
         // Total points
         int total_points;
+        // Storage order of the values, number of bricks along each axis and number of stored values with the padding
+        GridLayout layout;
+        int num_bricks[3];
+        int storage_points;
         // Bounds of the Grid
         BBOX bounds;
         // Size of the voxels and inverse of width
@@ -30,6 +95,18 @@ namespace drdemo {
         Float *data;
         // Rendering minimum distance tollerance
         float min_dist;
+        // Empty space skipping pyramid, from the finest level
+        std::vector<SkipLevel> skip_levels;
+        // Finite differences gradient at each point, in storage order
+        std::vector<Vector3f> gradients;
+        // If the pyramid and the gradients match the current values
+        bool caches_valid;
+        // Derivatives of the ray hits
+        HitDerivatives hit_derivatives;
+        // Algorithm used to intersect the rays
+        GridIntersector intersector;
+        // How the normals are computed
+        NormalMode normal_mode;
 
         // Private utility methods
         inline int OffsetPoint(int x, int y, int z) const {
@@ -43,7 +120,17 @@ namespace drdemo {
             if (z >= num_points[2]) { z -= num_points[2]; }
             else if (z < 0) { z += num_points[2]; }
 
-            return z * num_points[0] * num_points[1] + y * num_points[0] + x;
+            return StorageIndex(x, y, z);
+        }
+
+        // Position of a point inside the grid in the storage
+        inline int StorageIndex(int x, int y, int z) const {
+            if (layout == GridLayout::LINEAR) { return z * num_points[0] * num_points[1] + y * num_points[0] + x; }
+            const int mask = GRID_BRICK_SIZE - 1;
+            const int brick = ((z >> GRID_BRICK_LOG2) * num_bricks[1] + (y >> GRID_BRICK_LOG2)) * num_bricks[0] +
+                              (x >> GRID_BRICK_LOG2);
+            return (brick << (3 * GRID_BRICK_LOG2)) +
+                   ((((z & mask) << GRID_BRICK_LOG2) + (y & mask)) << GRID_BRICK_LOG2) + (x & mask);
         }
 
         inline int OffsetVoxel(int x, int y, int z) const {
@@ -62,18 +149,85 @@ namespace drdemo {
         // The indices start from the corner with the smallest (x,y,z) coordinates and then follow the order of the grid
         void PointsIndicesFromVoxel(int x, int y, int z, int *indices) const;
 
+        // Find the indices of the vertices of the voxel containing p and the local coordinates of p inside it
+        void VoxelLookup(const Vector3f &p, int *indices, Vector3f *t) const;
+
         // Compute normal at given point inside the SDF using tri-linear interpolation
         Vector3F NormalAt(const Vector3F &p) const;
 
+        Vector3f NormalAt(const Vector3f &p) const;
+
+        // Get the grid points and weights of the finite difference along axis at a grid point, returns their number
+        int DifferenceStencil(int x, int y, int z, int axis, int *indices, float *weights) const;
+
+        // Interpolate the cached gradients of the vertices of a voxel at p, recorded as one node per component whose parents are
+        // the grid values of the finite differences and the coordinates of p
+        Vector3F CachedNormalAt(const Vector3F &p, int const *indices, Vector3f const &t) const;
+
+        // Build the empty space skipping pyramid
+        void UpdateSkipLevels();
+
+        // Compute the gradient of all the points, in parallel
+        void UpdateGradients();
+
+        // Set the layout and the number of stored values, the dimensions must be set
+        void SetLayout(GridLayout grid_layout);
+
+        // Copy the values of all the points given in x, y, z order to the storage, filling the padding
+        void CopyValues(float const *values);
+
+        // Register the stored values as the variables of the shape, the padding points are left as constants
+        void RegisterValues();
+
+        // Values of all the points in x, y, z order
+        std::vector<float> LinearValues() const;
+
+        // Load the grid from a binary SDF file
+        void LoadBinary(const std::string &sdf_file, GridLayout grid_layout);
+
+        // Ray parameter increment that takes the point at parameter t out of the largest pyramid cell without surface
+        // containing it. Zero if the point is in a cell that may contain the surface
+        float SkipCellExit(Vector3f const &o, Vector3f const &d, float t) const;
+
+        // Same as SkipCellExit, or the sphere tracing step if longer
+        float SkipDistance(Vector3f const &o, Vector3f const &d, float t) const;
+
+        // Sphere trace the grid, used by both the Float and the passive intersection routines
+        template<typename T>
+        bool SphereTrace(TRay<T> const &ray, TInteraction<T> *interaction) const;
+
+        template<typename T>
+        bool SphereTraceP(TRay<T> const &ray) const;
+
+        // Fill the interaction of a hit at the given ray parameter
+        template<typename T>
+        void FillInteraction(TRay<T> const &ray, T const &depth, TInteraction<T> *interaction) const;
+
+        // Passive ValueAt of the points of a packet, p[axis][lane], only for the lanes with mask set
+        void PacketValueAt(float const (*p)[RAY_PACKET_SIZE], bool const *mask, float *values) const;
+
+        // Sphere trace the rays of a packet together, each lane stops on its own hit or miss like SphereTrace.
+        // t_hit is set for the lanes with hits
+        void SphereTracePacket(RayPacketf const &packet, bool *hits, float *t_hit) const;
+
+        // Find the first zero of the grid along the ray visiting the voxels with a 3D DDA, false if there is none
+        bool TraverseCells(Rayf const &ray, float *t_hit) const;
+
+        // Fill the interaction of a hit found without recording it on the tape, the hit parameter is differentiated
+        // implicitly
+        void ImplicitHit(Ray const &ray, float t, Interaction *interaction) const;
+
     public:
         // Default constructor, initialises an empty grid
-        SignedDistanceGrid(int n_x, int n_y, int n_z, BBOX const &b);
+        SignedDistanceGrid(int n_x, int n_y, int n_z, BBOX const &b, GridLayout grid_layout = GridLayout::LINEAR);
 
-        // Construct grid from values
-        SignedDistanceGrid(int n_x, int n_y, int n_z, BBOX const &b, float const *raw_data);
+        // Construct grid from values, given in x, y, z order whatever the layout
+        SignedDistanceGrid(int n_x, int n_y, int n_z, BBOX const &b, float const *raw_data,
+                           GridLayout grid_layout = GridLayout::LINEAR);
 
-        // Construct grid from file, input file from https://github.com/christopherbatty/SDFGen
-        explicit SignedDistanceGrid(const std::string &sdf_file);
+        // Construct grid from file, input file from https://github.com/christopherbatty/SDFGen or in the binary format
+        // of sdf_file.hpp, which is detected from its header
+        explicit SignedDistanceGrid(const std::string &sdf_file, GridLayout grid_layout = GridLayout::LINEAR);
 
         // Destructor
         ~SignedDistanceGrid();
@@ -83,17 +237,31 @@ namespace drdemo {
             return data[OffsetPoint(x, y, z)];
         }
 
-        inline Float &operator()(int x, int y, int z) {
-            return data[OffsetPoint(x, y, z)];
+        // Set the value of the grid point at given indices, keeping its variable. The caches are not used until
+        // UpdateCaches is called
+        inline void SetValue(int x, int y, int z, float value) {
+            data[OffsetPoint(x, y, z)].SetValue(value);
+            caches_valid = false;
         }
 
         // Compute the value of the Signed Distance Function sampled by the grid using trilinear interpolation given
         // a point in the grid
         Float ValueAt(const Vector3F &p) const;
 
+        float ValueAt(const Vector3f &p) const;
+
         // Compute the normal at a given grid point, last argument is to use backward difference
         Vector3F NormalAtPoint(int x, int y, int z) const;
 
+        // Passive version of NormalAtPoint, does not record anything on the tape
+        Vector3f NormalAtPointf(int x, int y, int z) const;
+
+        // Sum over all the points of (|NormalAtPoint|^2 - 1)^2, the normal regularization of the reconstruction
+        // energies. The term is a fixed stencil over the values, so its gradient is computed in closed form instead
+        // of being recorded on the tape: scale times the derivative with respect to each value is added to gradient,
+        // in the order of GetDiffVariables, unless it is null
+        float NormalRegularization(float *gradient = nullptr, float scale = 1.f) const;
+
         // Access size of the voxels
         inline Vector3f const &VoxelSize() const { return width; }
 
@@ -111,14 +279,42 @@ namespace drdemo {
             return num_points[axis];
         }
 
+        // Storage order of the values
+        inline GridLayout Layout() const { return layout; }
+
+        // Set how the derivatives of the ray hits are computed, MARCHING by default
+        inline void SetHitDerivatives(HitDerivatives mode) { hit_derivatives = mode; }
+
+        inline HitDerivatives HitDerivativesMode() const { return hit_derivatives; }
+
+        // Set the algorithm used to intersect the rays, SPHERE_TRACING by default
+        inline void SetIntersector(GridIntersector grid_intersector) { intersector = grid_intersector; }
+
+        inline GridIntersector Intersector() const { return intersector; }
+
+        // Set how the normals are computed, INTERPOLATED by default
+        inline void SetNormalMode(NormalMode mode) { normal_mode = mode; }
+
+        inline NormalMode GetNormalMode() const { return normal_mode; }
+
         // Convert 3 indices to linear
         inline int LinearIndex(int x, int y, int z) const {
             return OffsetPoint(x, y, z);
         }
 
         // Convert linear index to 3 indices
-        // TODO Check this again, should be correct
         inline void IndicesFromLinear(int linear_index, int &x, int &y, int &z) const {
+            if (layout == GridLayout::BRICKED) {
+                const int mask = GRID_BRICK_SIZE - 1;
+                const int brick = linear_index >> (3 * GRID_BRICK_LOG2);
+                const int b_x = brick % num_bricks[0];
+                const int b_y = (brick / num_bricks[0]) % num_bricks[1];
+                const int b_z = brick / (num_bricks[0] * num_bricks[1]);
+                x = (b_x << GRID_BRICK_LOG2) + (linear_index & mask);
+                y = (b_y << GRID_BRICK_LOG2) + ((linear_index >> GRID_BRICK_LOG2) & mask);
+                z = (b_z << GRID_BRICK_LOG2) + ((linear_index >> (2 * GRID_BRICK_LOG2)) & mask);
+                return;
+            }
             // Compute z index
             z = linear_index / (num_points[0] * num_points[1]);
             linear_index -= z * (num_points[0] * num_points[1]);
@@ -129,17 +325,38 @@ namespace drdemo {
             x = linear_index;
         }
 
+        // Recompute the empty space skipping pyramid and the gradients cache from the current values. It is done by
+        // the constructors, Refine, UpdateDiffVariables and SetDiffVariables, it must be called after changing the
+        // values with SetValue
+        void UpdateCaches();
+
         // Refine grid to new higher resolution resolution
         void Refine(int const *new_dims);
 
+        // Turn the values back into a signed distance field keeping their zero level set, solving |grad(phi)| = 1
+        // with the fast sweeping method. The points next to the surface get the distance to the linearly
+        // interpolated crossings and the others are swept in the eight orderings of the axes, split between the
+        // threads. Only the points closer than band to the surface are changed. The variables keep their tape nodes,
+        // so it can be called between optimizer iterations
+        void Redistance(float band = INFINITY, int max_iterations = REDISTANCE_MAX_ITERATIONS);
+
         // Write grid to file, same format as the constructor one
         void ToFile(const std::string &file_name) const;
 
+        // Write grid to a binary SDF file, much faster to write and load than the text one
+        void ToBinaryFile(const std::string &file_name) const;
+
         // Shape methods
         bool Intersect(Ray const &ray, Interaction *interaction) const override;
 
         bool IntersectP(Ray const &ray) const override;
 
+        bool Intersect(Rayf const &ray, Interactionf *interaction) const override;
+
+        bool IntersectP(Rayf const &ray) const override;
+
+        void IntersectPacket(RayPacketf const &packet, Interactionf *interactions, bool *hits) const override;
+
         BBOX BBox() const override;
 
         Vector3f Centroid() const override;
@@ -156,23 +373,6 @@ namespace drdemo {
         void SetDiffVariables(const std::vector<float> &vals, size_t starting_index) override;
     };
 
-
-//    /**
-//     * Reinitialization equation utilities
-//     */
-//
-//    // Compute squared norm of the gradient using forward finite difference method
-//    float GradNorm2(const SignedDistanceGrid &grid, int x, int y, int z);
-//
-//    // Compute sign grid
-//    void ComputeSignGrid(const SignedDistanceGrid &grid, float *sign_grid);
-//
-//    // Compute right part of PDF
-//    float RightTermReinitializePDE(const SignedDistanceGrid &grid, const float *sign_grid, int x, int y, int z);
-//
-//    // Reinitialize SDF
-//    void ReinitializeSDF(SignedDistanceGrid &grid, float dt, size_t max_iters, float tolerance, float band);
-
 } // drdemo namespace
 
 #endif //DRDEMO_GRID_HPP
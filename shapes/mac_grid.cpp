@@ -3,7 +3,10 @@
 //
 
 #include <iofile.hpp>
+#include <sdf_file.hpp>
+#include <parallel.hpp>
 #include "mac_grid.hpp"
+#include "trilinear.hpp"
 
 namespace drdemo {
 
@@ -20,12 +23,16 @@ namespace drdemo {
             v_width[axis] = e[axis] / (float) (dims[axis]);
             inv_v_width[axis] = (v_width[axis] == 0.f) ? 0.f : 1.f / v_width[axis];
         }
+        // The voxel values are the differentiable variables of the shape
+        Float::RegisterVariables(values, static_cast<size_t>(total_voxels));
     }
 
     MACGrid::MACGrid(const std::string &sdf_file) {
         // Start by trying to reading the file
         std::vector<std::string> sdf_file_lines;
-        if (ReadFile(sdf_file, sdf_file_lines)) {
+        if (IsBinarySDFFile(sdf_file)) {
+            LoadBinary(sdf_file);
+        } else if (ReadFile(sdf_file, sdf_file_lines)) {
             // No check on the format, we expect the file to be correct
             int n_x, n_y, n_z;
             // Get grid dimension from first line
@@ -83,9 +90,36 @@ namespace drdemo {
             std::cerr << "Error trying to open SDF file!" << std::endl;
             exit(EXIT_FAILURE);
         }
+        // The voxel values are the differentiable variables of the shape
+        Float::RegisterVariables(values, static_cast<size_t>(total_voxels));
+    }
+
+    void MACGrid::LoadBinary(const std::string &sdf_file) {
+        // The file is mapped and the values copied as they are, no parsing needed
+        MappedSDFFile file;
+        if (!file.Open(sdf_file)) {
+            std::cerr << "Error trying to open binary SDF file!" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        SDFFileHeader const &header = file.Header();
+        for (int axis = 0; axis < 3; ++axis) {
+            dims[axis] = header.dims[axis];
+            v_width[axis] = header.voxel_size[axis];
+            inv_v_width[axis] = (v_width[axis] == 0.f) ? 0.f : 1.f / v_width[axis];
+        }
+        total_voxels = dims[0] * dims[1] * dims[2];
+        bounds = BBOX(Vector3f(header.bbox_min[0], header.bbox_min[1], header.bbox_min[2]),
+                      Vector3f(header.bbox_max[0], header.bbox_max[1], header.bbox_max[2]));
+        // Copy values
+        values = new Float[total_voxels];
+        float const *const file_values = file.Values();
+        for (int i = 0; i < total_voxels; ++i) {
+            values[i] = file_values[i];
+        }
     }
 
     MACGrid::~MACGrid() {
+        Float::UnregisterVariables(values);
         delete[] values;
     }
 
@@ -93,7 +127,7 @@ namespace drdemo {
         // Convert position to plain float for bbox
         const Vector3f p_float = Tofloat(p);
         // Compute bounds of "internal" grid
-        const BBOX internal_bounds(bounds.MinPoint() + 0.5f * v_width, bounds.MaxPoint() - 0.5f * v_width);
+        const BBOX internal_bounds = InternalBounds();
         // Check if we are outside of the grid
         if (!internal_bounds.Inside(p_float)) {
             return Float(internal_bounds.Distance(p_float) + 0.001f);
@@ -219,15 +253,82 @@ namespace drdemo {
         // TODO
     }
 
+    float MACGrid::SampleClamped(const Vector3f &p) const {
+        // Clamp the point to the voxels centers, the values are extended constantly outside them
+        const BBOX internal_bounds = InternalBounds();
+        int v_i[3];
+        Vector3f t;
+        for (int i = 0; i < 3; ++i) {
+            const float coord = Clamp(p[i], internal_bounds.MinPoint()[i], internal_bounds.MaxPoint()[i]);
+            const float voxel_coord = (coord - internal_bounds.MinPoint()[i]) * inv_v_width[i];
+            v_i[i] = Clamp(static_cast<int>(voxel_coord), 0, std::max(dims[i] - 2, 0));
+            t[i] = dims[i] > 1 ? voxel_coord - v_i[i] : 0.f;
+        }
+
+        // Values at the centers around the point, in the order of the trilinear interpolation
+        float corner_values[8];
+        for (int c = 0; c < 8; c++) {
+            const int i = std::min(v_i[0] + (c & 1), dims[0] - 1);
+            const int j = std::min(v_i[1] + ((c >> 1) & 1), dims[1] - 1);
+            const int k = std::min(v_i[2] + (c >> 2), dims[2] - 1);
+            corner_values[c] = values[OffsetVoxel(i, j, k)].GetValue();
+        }
+        return Trilinear(corner_values, t);
+    }
+
     void MACGrid::Refine(const int *new_dims) {
-        // TODO
+        // Compute new voxel size, the bounds do not change
+        const Vector3f e = bounds.Extent();
+        Vector3f new_width, new_inv_width;
+        for (int axis = 0; axis < 3; ++axis) {
+            new_width[axis] = e[axis] / static_cast<float>(new_dims[axis]);
+            new_inv_width[axis] = (new_width[axis] == 0.f) ? 0.f : 1.f / new_width[axis];
+        }
+
+        // Resample the current grid at the new voxels centers on plain floats, nothing is recorded on the tape. The
+        // slices along z are split between the threads, each one writes its own part of the new values
+        const size_t slice = static_cast<size_t>(new_dims[0]) * new_dims[1];
+        const int new_total = new_dims[0] * new_dims[1] * new_dims[2];
+        std::vector<float> new_values(static_cast<size_t>(new_total));
+        ParallelFor(0, static_cast<size_t>(new_dims[2]), [&](size_t, size_t k_begin, size_t k_end) {
+            for (size_t k = k_begin; k < k_end; k++) {
+                float *const slice_values = new_values.data() + k * slice;
+                for (int j = 0; j < new_dims[1]; j++) {
+                    for (int i = 0; i < new_dims[0]; i++) {
+                        const Vector3f p(bounds.MinPoint().x + (i + 0.5f) * new_width.x,
+                                         bounds.MinPoint().y + (j + 0.5f) * new_width.y,
+                                         bounds.MinPoint().z + (k + 0.5f) * new_width.z);
+                        slice_values[j * new_dims[0] + i] = SampleClamped(p);
+                    }
+                }
+            }
+        });
+
+        // Set the new values, they become the variables in a single contiguous block
+        Float *const old_values = values;
+        for (int axis = 0; axis < 3; ++axis) { dims[axis] = new_dims[axis]; }
+        v_width = new_width;
+        inv_v_width = new_inv_width;
+        total_voxels = new_total;
+        values = new Float[total_voxels];
+        for (int i = 0; i < total_voxels; ++i) { values[i] = new_values[i]; }
+        Float::RegisterVariables(values, static_cast<size_t>(total_voxels));
+
+        // Free old memory, its variables are not parameters anymore
+        Float::UnregisterVariables(old_values);
+        delete[] old_values;
     }
 
     bool MACGrid::Intersect(Ray const &ray, Interaction *interaction) const {
         // The intersection procedure uses ray marching to check if we have an interaction with the stored surface
 
-        // Current depth
-        Float depth(0.f);
+        // Clip the ray to the grid bounds, outside the centers of the voxels there is no surface
+        float t_enter, t_exit;
+        if (!InternalBounds().Intersect(ray, &t_enter, &t_exit)) { return false; }
+        t_exit = std::min(t_exit, MAX_DIST);
+
+        // Current depth, the marching starts where the ray enters the grid
+        Float depth(t_enter);
 
         // Find tollerance
         const float min_dist = std::min(MIN_DIST, std::min(std::min(v_width.x, v_width.y), v_width.z));
@@ -251,12 +352,15 @@ namespace drdemo {
                 // Set albedo to 1
                 interaction->albedo = Spectrum(1.f);
 
+                // Update new ray maximum value
+                ray.t_max = depth;
+
                 return true;
             }
             // Increase distance
             depth += distance;
             // Check for end
-            if (depth > MAX_DIST) { return false; }
+            if (depth > t_exit) { return false; }
         }
         return false;
     }
@@ -264,8 +368,13 @@ namespace drdemo {
     bool MACGrid::IntersectP(Ray const &ray) const {
         // The intersection procedure uses ray marching to check if we have a hit with the surface
 
-        // Current depth
-        Float depth(0.f);
+        // Clip the ray to the grid bounds
+        float t_enter, t_exit;
+        if (!InternalBounds().Intersect(ray, &t_enter, &t_exit)) { return false; }
+        t_exit = std::min(t_exit, MAX_DIST);
+
+        // Current depth, the marching starts where the ray enters the grid
+        Float depth(t_enter);
 
         for (int steps = 0; steps < MAX_STEPS; steps++) {
             // Compute distance from surface
@@ -275,7 +384,7 @@ namespace drdemo {
             // Increase distance
             depth += distance;
             // Check for end
-            if (depth > MAX_DIST) { return false; }
+            if (depth > t_exit) { return false; }
         }
         return false;
     }
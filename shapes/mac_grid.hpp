@@ -41,17 +41,30 @@ namespace drdemo {
             return Clamp(index, 0, dims[axis] - 1);
         }
 
+        // Bounds of the voxels centers, the values are interpolated only inside them
+        inline BBOX InternalBounds() const {
+            return BBOX(bounds.MinPoint() + 0.5f * v_width, bounds.MaxPoint() - 0.5f * v_width);
+        }
+
         // Compute normal at given point
         Vector3F NormalAt(const Vector3F &p) const;
 
         // Compute normal given indices
         Vector3F NormalAt(int i, int j, int k) const;
 
+        // Load the grid from a binary SDF file
+        void LoadBinary(const std::string &sdf_file);
+
+        // Interpolate the values at a point without recording anything on the tape, the point is clamped to the
+        // voxels centers
+        float SampleClamped(const Vector3f &p) const;
+
     public:
         // Create and empty grid
         MACGrid(int nx, int ny, int nz, const BBOX &b);
 
-        // Construct grid from file, input file from https://github.com/christopherbatty/SDFGen
+        // Construct grid from file, input file from https://github.com/christopherbatty/SDFGen or in the binary format
+        // of sdf_file.hpp
         explicit MACGrid(const std::string &sdf_file);
 
         // Destructor
@@ -81,7 +94,7 @@ namespace drdemo {
         // Get grid dimension along axis
         inline int Dim(int axis) const { return dims[axis]; }
 
-        // Refine grid
+        // Refine grid to the new number of voxels, keeping the bounds
         void Refine(const int new_dims[3]);
 
         // Shape methods
@@ -89,6 +102,10 @@ namespace drdemo {
 
         bool IntersectP(Ray const &ray) const override;
 
+        // The passive intersection routines fall back to the Float ones
+        using Shape::Intersect;
+        using Shape::IntersectP;
+
         BBOX BBox() const override;
 
         Vector3f Centroid() const override;
@@ -0,0 +1,368 @@
+#include <sdf_file.hpp>
+#include "sparse_grid.hpp"
+#include "trilinear.hpp"
+
+namespace drdemo {
+
+    SparseSignedDistanceGrid::SparseSignedDistanceGrid(int n_x, int n_y, int n_z, BBOX const &b,
+                                                       float const *const raw_data, int band_voxels) {
+        // Set number of points along each dimension
+        num_points[0] = n_x;
+        num_points[1] = n_y;
+        num_points[2] = n_z;
+        // Set bounds
+        bounds = b;
+        // Compute voxel width
+        const Vector3f extent = bounds.Extent();
+        for (int axis = 0; axis < 3; ++axis) {
+            width[axis] = extent[axis] / static_cast<float>(num_points[axis] - 1);
+            inv_width[axis] = (width[axis] == 0.f) ? 0.f : 1.f / width[axis];
+        }
+        Build(raw_data, band_voxels);
+    }
+
+    SparseSignedDistanceGrid::SparseSignedDistanceGrid(const std::string &sdf_file, int band_voxels) {
+        // Take dimensions, bounds and voxel size from the header of the file
+        auto set_dimensions = [&](SDFFileHeader const &header) {
+            for (int axis = 0; axis < 3; ++axis) {
+                num_points[axis] = header.dims[axis];
+                width[axis] = header.voxel_size[axis];
+                inv_width[axis] = (width[axis] == 0.f) ? 0.f : 1.f / width[axis];
+            }
+            bounds = BBOX(Vector3f(header.bbox_min[0], header.bbox_min[1], header.bbox_min[2]),
+                          Vector3f(header.bbox_max[0], header.bbox_max[1], header.bbox_max[2]));
+        };
+
+        if (IsBinarySDFFile(sdf_file)) {
+            MappedSDFFile file;
+            if (!file.Open(sdf_file)) {
+                std::cerr << "Error trying to open binary SDF file!" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            set_dimensions(file.Header());
+            Build(file.Values(), band_voxels);
+        } else {
+            SDFFileHeader header;
+            std::vector<float> values;
+            if (!ReadTextSDFFile(sdf_file, &header, &values)) {
+                std::cerr << "Error trying to open SDF file!" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            set_dimensions(header);
+            Build(values.data(), band_voxels);
+        }
+    }
+
+    SparseSignedDistanceGrid::~SparseSignedDistanceGrid() {
+        // Without stored bricks no variable was registered
+        if (stored_bricks > 0) { Float::UnregisterVariables(data); }
+        delete[] data;
+    }
+
+    template<typename F>
+    void SparseSignedDistanceGrid::ForEachStoredPoint(F const &f) const {
+        // The stored bricks are numbered in the order of the brick table
+        size_t brick = 0;
+        for (int b_z = 0; b_z < num_bricks[2]; b_z++) {
+            for (int b_y = 0; b_y < num_bricks[1]; b_y++) {
+                for (int b_x = 0; b_x < num_bricks[0]; b_x++, brick++) {
+                    if (brick_table[brick] < 0) { continue; }
+                    size_t index = static_cast<size_t>(brick_table[brick]) * SPARSE_BRICK_POINTS;
+                    for (int z = b_z * SPARSE_BRICK_SIZE; z < (b_z + 1) * SPARSE_BRICK_SIZE; z++) {
+                        for (int y = b_y * SPARSE_BRICK_SIZE; y < (b_y + 1) * SPARSE_BRICK_SIZE; y++) {
+                            for (int x = b_x * SPARSE_BRICK_SIZE; x < (b_x + 1) * SPARSE_BRICK_SIZE; x++, index++) {
+                                f(index, x < num_points[0] && y < num_points[1] && z < num_points[2]);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    void SparseSignedDistanceGrid::Build(float const *const values, int band_voxels) {
+        // The band must be larger than a voxel so that all the voxels crossed by the surface are stored
+        band = static_cast<float>(band_voxels) * std::max(std::max(width.x, width.y), width.z);
+        outside_value = Float(band);
+        inside_value = Float(-band);
+        for (int axis = 0; axis < 3; ++axis) {
+            num_bricks[axis] = (num_points[axis] + SPARSE_BRICK_SIZE - 1) >> SPARSE_BRICK_LOG2;
+        }
+        const size_t table_size = static_cast<size_t>(num_bricks[0]) * num_bricks[1] * num_bricks[2];
+        const size_t slice = static_cast<size_t>(num_points[0]) * num_points[1];
+
+        // Find the bricks with at least one point in the band
+        std::vector<bool> in_band(table_size, false);
+        size_t index = 0;
+        for (int z = 0; z < num_points[2]; z++) {
+            for (int y = 0; y < num_points[1]; y++) {
+                for (int x = 0; x < num_points[0]; x++, index++) {
+                    if (std::abs(values[index]) <= band) { in_band[BrickOffset(x, y, z)] = true; }
+                }
+            }
+        }
+
+        // Number the stored bricks, the other ones are on one side of the surface as a whole
+        brick_table.resize(table_size);
+        stored_bricks = 0;
+        size_t brick = 0;
+        for (int z = 0; z < num_bricks[2]; z++) {
+            for (int y = 0; y < num_bricks[1]; y++) {
+                for (int x = 0; x < num_bricks[0]; x++, brick++) {
+                    if (in_band[brick]) {
+                        brick_table[brick] = stored_bricks++;
+                    } else {
+                        const size_t first_point = static_cast<size_t>(z) * SPARSE_BRICK_SIZE * slice +
+                                                   static_cast<size_t>(y) * SPARSE_BRICK_SIZE * num_points[0] +
+                                                   x * SPARSE_BRICK_SIZE;
+                        brick_table[brick] = values[first_point] < 0.f ? EMPTY_INSIDE : EMPTY_OUTSIDE;
+                    }
+                }
+            }
+        }
+
+        // Copy the values of the stored bricks, the points past the end of the grid are left outside
+        const size_t total_values = static_cast<size_t>(stored_bricks) * SPARSE_BRICK_POINTS;
+        data = new Float[total_values];
+        for (size_t i = 0; i < total_values; ++i) { data[i] = band; }
+        index = 0;
+        for (int z = 0; z < num_points[2]; z++) {
+            for (int y = 0; y < num_points[1]; y++) {
+                for (int x = 0; x < num_points[0]; x++, index++) {
+                    const int b = brick_table[BrickOffset(x, y, z)];
+                    if (b >= 0) { data[b * SPARSE_BRICK_POINTS + OffsetInBrick(x, y, z)] = values[index]; }
+                }
+            }
+        }
+
+        // The stored values are the differentiable variables of the shape. The points of the bricks past the end of the
+        // grid are never read, they are left as constants and are not part of the variables
+        Float::RegisterVariables(data, total_values);
+        num_vars = 0;
+        ForEachStoredPoint([&](size_t i, bool in_grid) {
+            if (in_grid) {
+                num_vars++;
+            } else {
+                data[i] = Float(band);
+            }
+        });
+        // Compute minimum distance tolerance, must be smaller than cell size
+        min_dist = std::min(MIN_DIST, std::min(std::min(width.x, width.y), width.z) / 2.f);
+    }
+
+    void SparseSignedDistanceGrid::VoxelLookup(const Vector3f &p, int *const voxel, Vector3f *const t) const {
+        // Get voxel indices
+        for (int i = 0; i < 3; i++) {
+            voxel[i] = PosToVoxel(p, i);
+        }
+
+        // Local coordinates of the point inside the voxel
+        *t = Vector3f((p.x - (bounds.MinPoint().x + voxel[0] * width.x)) * inv_width.x,
+                      (p.y - (bounds.MinPoint().y + voxel[1] * width.y)) * inv_width.y,
+                      (p.z - (bounds.MinPoint().z + voxel[2] * width.z)) * inv_width.z);
+    }
+
+    void SparseSignedDistanceGrid::VoxelValues(int const *const voxel, Float const **const values) const {
+        for (int i = 0; i < 8; i++) {
+            values[i] = &(*this)(voxel[0] + (i & 1), voxel[1] + ((i >> 1) & 1), voxel[2] + (i >> 2));
+        }
+    }
+
+    Float SparseSignedDistanceGrid::ValueAt(const Vector3F &p) const {
+        // Convert position
+        const Vector3f p_f = Tofloat(p);
+        // Check if we are outside the BBOX
+        if (!bounds.Inside(p_f)) {
+            return Float(bounds.Distance(p_f) + 0.001f);
+        }
+
+        int voxel[3];
+        Vector3f t;
+        VoxelLookup(p_f, voxel, &t);
+        Float const *values[8];
+        VoxelValues(voxel, values);
+
+        return TrilinearNode(values, p, t, inv_width);
+    }
+
+    float SparseSignedDistanceGrid::ValueAt(const Vector3f &p) const {
+        // Check if we are outside the BBOX
+        if (!bounds.Inside(p)) {
+            return bounds.Distance(p) + 0.001f;
+        }
+
+        int voxel[3];
+        Vector3f t;
+        VoxelLookup(p, voxel, &t);
+        Float const *points[8];
+        VoxelValues(voxel, points);
+
+        float values[8];
+        for (int i = 0; i < 8; i++) { values[i] = points[i]->GetValue(); }
+
+        return Trilinear(values, t);
+    }
+
+    Vector3F SparseSignedDistanceGrid::NormalAt(const Vector3F &p) const {
+        int voxel[3];
+        Vector3f t;
+        VoxelLookup(Tofloat(p), voxel, &t);
+
+        // Compute normal at the 8 vertices of the voxel
+        Vector3F normals[8];
+        for (int i = 0; i < 8; i++) {
+            normals[i] = NormalAtPoint(voxel[0] + (i & 1), voxel[1] + ((i >> 1) & 1), voxel[2] + (i >> 2));
+        }
+
+        // Interpolate each component of the normals
+        Float const *values_x[8], *values_y[8], *values_z[8];
+        for (int i = 0; i < 8; i++) {
+            values_x[i] = &normals[i].x;
+            values_y[i] = &normals[i].y;
+            values_z[i] = &normals[i].z;
+        }
+
+        return Vector3F(TrilinearNode(values_x, p, t, inv_width),
+                        TrilinearNode(values_y, p, t, inv_width),
+                        TrilinearNode(values_z, p, t, inv_width));
+    }
+
+    Vector3f SparseSignedDistanceGrid::NormalAt(const Vector3f &p) const {
+        int voxel[3];
+        Vector3f t;
+        VoxelLookup(p, voxel, &t);
+
+        // Compute normal at the 8 vertices of the voxel
+        float values_x[8], values_y[8], values_z[8];
+        for (int i = 0; i < 8; i++) {
+            const Vector3f n = NormalAtPointf(voxel[0] + (i & 1), voxel[1] + ((i >> 1) & 1), voxel[2] + (i >> 2));
+            values_x[i] = n.x;
+            values_y[i] = n.y;
+            values_z[i] = n.z;
+        }
+
+        return Vector3f(Trilinear(values_x, t), Trilinear(values_y, t), Trilinear(values_z, t));
+    }
+
+    int SparseSignedDistanceGrid::DifferenceStencil(int x, int y, int z, int axis, Float const **const points,
+                                                    float *const weights) const {
+        const int coords[3] = {x, y, z};
+        int offsets[3];
+        const int n = DifferenceOffsets(coords[axis], num_points[axis], inv_width[axis], offsets, weights);
+        for (int i = 0; i < n; i++) {
+            int point[3] = {x, y, z};
+            point[axis] += offsets[i];
+            points[i] = &(*this)(point[0], point[1], point[2]);
+        }
+        return n;
+    }
+
+    Vector3F SparseSignedDistanceGrid::NormalAtPoint(int x, int y, int z) const {
+        // Compute the derivative along a given axis as a single node
+        auto derivative = [&](int axis) {
+            Float const *points[3];
+            float weights[3];
+            const int n = DifferenceStencil(x, y, z, axis, points, weights);
+            float value = 0.f;
+            for (int i = 0; i < n; i++) { value += weights[i] * points[i]->GetValue(); }
+            return FusedNode(value, static_cast<size_t>(n), weights, points);
+        };
+
+        return Vector3F(derivative(0), derivative(1), derivative(2));
+    }
+
+    Vector3f SparseSignedDistanceGrid::NormalAtPointf(int x, int y, int z) const {
+        float derivatives[3];
+        for (int axis = 0; axis < 3; axis++) {
+            Float const *points[3];
+            float weights[3];
+            const int n = DifferenceStencil(x, y, z, axis, points, weights);
+            derivatives[axis] = 0.f;
+            for (int i = 0; i < n; i++) { derivatives[axis] += weights[i] * points[i]->GetValue(); }
+        }
+
+        return Vector3f(derivatives[0], derivatives[1], derivatives[2]);
+    }
+
+    template<typename T>
+    bool SparseSignedDistanceGrid::SphereTrace(TRay<T> const &ray, TInteraction<T> *const interaction) const {
+        // Same ray marching as SignedDistanceGrid without the empty space skipping, outside the band the steps are as
+        // long as the band
+        T depth;
+        if (!SphereTraceDepth(ray, bounds, min_dist, [this](Vector3<T> const &p) { return ValueAt(p); },
+                              [](float) { return 0.f; }, &depth)) {
+            return false;
+        }
+        FillGridInteraction(ray, depth, [this](Vector3<T> const &p) { return NormalAt(p); }, interaction);
+        return true;
+    }
+
+    template<typename T>
+    bool SparseSignedDistanceGrid::SphereTraceP(TRay<T> const &ray) const {
+        T depth;
+        return SphereTraceDepth(ray, bounds, min_dist, [this](Vector3<T> const &p) { return ValueAt(p); },
+                                [](float) { return 0.f; }, &depth);
+    }
+
+    bool SparseSignedDistanceGrid::Intersect(Ray const &ray, Interaction *const interaction) const {
+        return SphereTrace(ray, interaction);
+    }
+
+    bool SparseSignedDistanceGrid::IntersectP(Ray const &ray) const {
+        return SphereTraceP(ray);
+    }
+
+    bool SparseSignedDistanceGrid::Intersect(Rayf const &ray, Interactionf *const interaction) const {
+        return SphereTrace(ray, interaction);
+    }
+
+    bool SparseSignedDistanceGrid::IntersectP(Rayf const &ray) const {
+        return SphereTraceP(ray);
+    }
+
+    BBOX SparseSignedDistanceGrid::BBox() const {
+        return bounds;
+    }
+
+    Vector3f SparseSignedDistanceGrid::Centroid() const {
+        return Vector3f(0.f, 0.f, 0.f);
+    }
+
+    std::string SparseSignedDistanceGrid::ToString() const {
+        std::string content("(");
+        ForEachStoredPoint([&](size_t i, bool in_grid) {
+            if (in_grid) {
+                if (content.size() > 1) { content += ", "; }
+                content += std::to_string(data[i].GetValue());
+            }
+        });
+        content += ")";
+
+        return content;
+    }
+
+    void SparseSignedDistanceGrid::GetDiffVariables(std::vector<Float const *> &vars) const {
+        ForEachStoredPoint([&](size_t i, bool in_grid) {
+            if (in_grid) { vars.push_back(&data[i]); }
+        });
+    }
+
+    size_t SparseSignedDistanceGrid::GetNumVars() const noexcept {
+        return num_vars;
+    }
+
+    void SparseSignedDistanceGrid::UpdateDiffVariables(const std::vector<float> &delta, size_t starting_index) {
+        size_t k = starting_index;
+        ForEachStoredPoint([&](size_t i, bool in_grid) {
+            if (in_grid) { data[i].SetValue(data[i].GetValue() + delta[k++]); }
+        });
+    }
+
+    void SparseSignedDistanceGrid::SetDiffVariables(const std::vector<float> &vals, size_t starting_index) {
+        size_t k = starting_index;
+        ForEachStoredPoint([&](size_t i, bool in_grid) {
+            if (in_grid) { data[i].SetValue(vals[k++]); }
+        });
+    }
+
+} // drdemo namespace
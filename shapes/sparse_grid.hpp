@@ -0,0 +1,185 @@
+#ifndef DRDEMO_SPARSE_GRID_HPP
+#define DRDEMO_SPARSE_GRID_HPP
+
+#include "shape.hpp"
+#include <vector>
+
+namespace drdemo {
+
+    // Number of points of a brick along each axis, must be a power of two
+    const int SPARSE_BRICK_LOG2 = 3;
+    const int SPARSE_BRICK_SIZE = 1 << SPARSE_BRICK_LOG2;
+    const int SPARSE_BRICK_POINTS = SPARSE_BRICK_SIZE * SPARSE_BRICK_SIZE * SPARSE_BRICK_SIZE;
+
+    // Default width of the band around the surface, in voxels
+    const int SPARSE_DEFAULT_BAND = 3;
+
+    /**
+     * Narrow band signed distance grid, the values are stored only close to the zero level set
+     *
+     * The points of the grid are split in bricks of SPARSE_BRICK_SIZE^3 points. A brick is stored densely if any of
+     * its points is closer than the band to the surface, the other ones only remember if they are inside or outside
+     * and read as -band or +band. The top level table gives the brick covering each block of points, so a lookup
+     * is two array accesses. Only the stored values are differentiable variables, so memory and optimization cost
+     * grow with the area of the surface instead of the volume of the grid.
+     *
+     * Like SignedDistanceGrid the values are at the vertices of the voxels and the storage order is x, y, z
+     */
+    class SparseSignedDistanceGrid : public Shape, public DiffObjectInterface {
+    private:
+        // Brick table entries of the bricks that are not stored
+        static const int EMPTY_OUTSIDE = -1;
+        static const int EMPTY_INSIDE = -2;
+
+        // Number of points and of bricks for each axis
+        int num_points[3];
+        int num_bricks[3];
+        // Bounds of the Grid
+        BBOX bounds;
+        // Size of the voxels and inverse of width
+        Vector3f width, inv_width;
+        // Distance from the surface up to which the values are stored
+        float band;
+        // Index of the brick covering each block of points, or EMPTY_OUTSIDE / EMPTY_INSIDE, in x, y, z order
+        std::vector<int> brick_table;
+        // Number of stored bricks and their values, SPARSE_BRICK_POINTS per brick in x, y, z order
+        int stored_bricks;
+        Float *data;
+        // Number of stored points inside the grid, the bricks on the far sides can extend past its end
+        size_t num_vars;
+        // Value of the points of the bricks that are not stored
+        Float outside_value, inside_value;
+        // Rendering minimum distance tolerance
+        float min_dist;
+
+        // Index of the brick table entry covering the point
+        inline int BrickOffset(int x, int y, int z) const {
+            return ((z >> SPARSE_BRICK_LOG2) * num_bricks[1] + (y >> SPARSE_BRICK_LOG2)) * num_bricks[0] +
+                   (x >> SPARSE_BRICK_LOG2);
+        }
+
+        // Offset of the point inside its brick
+        inline int OffsetInBrick(int x, int y, int z) const {
+            const int mask = SPARSE_BRICK_SIZE - 1;
+            return (((z & mask) << SPARSE_BRICK_LOG2) + (y & mask)) * SPARSE_BRICK_SIZE + (x & mask);
+        }
+
+        // Convert 3d point to VOXEL coordinate given an axis (0: x, 1: y, 2: z)
+        inline int PosToVoxel(const Vector3f &p, int axis) const {
+            auto v_i = static_cast<int>((p[axis] - bounds.MinPoint()[axis]) * inv_width[axis]);
+            return Clamp(v_i, 0, num_points[axis] - 2);
+        }
+
+        // Find the voxel containing p and the local coordinates of p inside it
+        void VoxelLookup(const Vector3f &p, int *voxel, Vector3f *t) const;
+
+        // Get the values at the eight vertices of a voxel, in the order of SignedDistanceGrid::PointsIndicesFromVoxel
+        void VoxelValues(int const *voxel, Float const **values) const;
+
+        // Compute normal at given point inside the SDF using tri-linear interpolation
+        Vector3F NormalAt(const Vector3F &p) const;
+
+        Vector3f NormalAt(const Vector3f &p) const;
+
+        // Get the grid points and weights of the finite difference along axis at a grid point, returns their number
+        int DifferenceStencil(int x, int y, int z, int axis, Float const **points, float *weights) const;
+
+        // Store the bricks close to the surface given the values of all the points, dimensions and width must be set
+        void Build(float const *values, int band_voxels);
+
+        // Call f(index, in_grid) for each point of the stored bricks in storage order, in_grid tells if the point is
+        // inside the grid
+        template<typename F>
+        void ForEachStoredPoint(F const &f) const;
+
+        // Sphere trace the grid, used by both the Float and the passive intersection routines
+        template<typename T>
+        bool SphereTrace(TRay<T> const &ray, TInteraction<T> *interaction) const;
+
+        template<typename T>
+        bool SphereTraceP(TRay<T> const &ray) const;
+
+    public:
+        // Construct grid from the values of all its points, only the ones in the band are kept
+        SparseSignedDistanceGrid(int n_x, int n_y, int n_z, BBOX const &b, float const *raw_data,
+                                 int band_voxels = SPARSE_DEFAULT_BAND);
+
+        // Construct grid from a text or binary SDF file, see SignedDistanceGrid. Binary files are read in place, so
+        // the dense grid is never allocated
+        explicit SparseSignedDistanceGrid(const std::string &sdf_file, int band_voxels = SPARSE_DEFAULT_BAND);
+
+        SparseSignedDistanceGrid(SparseSignedDistanceGrid const &other) = delete;
+
+        SparseSignedDistanceGrid &operator=(SparseSignedDistanceGrid const &other) = delete;
+
+        // Destructor
+        ~SparseSignedDistanceGrid();
+
+        // Access Grid point at given indices, points outside the band give -band or +band
+        inline Float const &operator()(int x, int y, int z) const {
+            const int brick = brick_table[BrickOffset(x, y, z)];
+            if (brick < 0) { return brick == EMPTY_INSIDE ? inside_value : outside_value; }
+            return data[brick * SPARSE_BRICK_POINTS + OffsetInBrick(x, y, z)];
+        }
+
+        // Check if the value of a point is stored
+        inline bool IsStored(int x, int y, int z) const {
+            return brick_table[BrickOffset(x, y, z)] >= 0;
+        }
+
+        // Compute the value of the Signed Distance Function sampled by the grid using trilinear interpolation given
+        // a point in the grid
+        Float ValueAt(const Vector3F &p) const;
+
+        float ValueAt(const Vector3f &p) const;
+
+        // Compute the normal at a given grid point
+        Vector3F NormalAtPoint(int x, int y, int z) const;
+
+        // Passive version of NormalAtPoint, does not record anything on the tape
+        Vector3f NormalAtPointf(int x, int y, int z) const;
+
+        // Access size of the voxels
+        inline Vector3f const &VoxelSize() const { return width; }
+
+        inline Vector3f const &InvVoxelSize() const { return inv_width; }
+
+        // Get grid dimensions
+        inline int Size(int axis) const {
+            return num_points[axis];
+        }
+
+        // Distance from the surface up to which the values are stored
+        inline float Band() const { return band; }
+
+        // Number of stored bricks
+        inline int NumBricks() const { return stored_bricks; }
+
+        // Shape methods
+        bool Intersect(Ray const &ray, Interaction *interaction) const override;
+
+        bool IntersectP(Ray const &ray) const override;
+
+        bool Intersect(Rayf const &ray, Interactionf *interaction) const override;
+
+        bool IntersectP(Rayf const &ray) const override;
+
+        BBOX BBox() const override;
+
+        Vector3f Centroid() const override;
+
+        std::string ToString() const override;
+
+        // Differentiable object methods, the variables are the values of the stored points inside the grid
+        void GetDiffVariables(std::vector<Float const *> &vars) const override;
+
+        size_t GetNumVars() const noexcept override;
+
+        void UpdateDiffVariables(const std::vector<float> &delta, size_t starting_index) override;
+
+        void SetDiffVariables(const std::vector<float> &vals, size_t starting_index) override;
+    };
+
+} // drdemo namespace
+
+#endif //DRDEMO_SPARSE_GRID_HPP
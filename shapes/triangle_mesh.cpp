@@ -22,7 +22,8 @@ namespace drdemo {
     Triangle::Triangle(TriangleMesh &mesh, uint32_t t_i)
             : mesh(mesh), triangle_index(t_i) {}
 
-    bool Triangle::Intersect(Ray const &ray, Interaction *const interaction) const {
+    template<typename T>
+    bool Triangle::RayIntersect(TRay<T> const &ray, TInteraction<T> *const interaction) const {
         // Get vertices from mesh
         Vector3f const &v0 = mesh.vertices[mesh.triangles[triangle_index].v[0]];
         Vector3f const &v1 = mesh.vertices[mesh.triangles[triangle_index].v[1]];
@@ -59,22 +60,25 @@ namespace drdemo {
         // Fill interaction
         interaction->p = ray(t);
 
+        Vector3f n;
         if (mesh.normals.empty()) {
-            interaction->n = ToFloat(Normalize(Cross(e1, e2)));
+            n = Normalize(Cross(e1, e2));
         } else {
-            interaction->n = ToFloat(Normalize((1.f - b1 - b2) * mesh.normals[mesh.triangles[triangle_index].n[0]] +
-                                               b1 * mesh.normals[mesh.triangles[triangle_index].n[1]] +
-                                               b2 * mesh.normals[mesh.triangles[triangle_index].n[2]]));
+            n = Normalize((1.f - b1 - b2) * mesh.normals[mesh.triangles[triangle_index].n[0]] +
+                          b1 * mesh.normals[mesh.triangles[triangle_index].n[1]] +
+                          b2 * mesh.normals[mesh.triangles[triangle_index].n[2]]);
         }
+        interaction->n = Vector3<T>(n.x, n.y, n.z);
         interaction->t = t;
         interaction->wo = Normalize(-ray.d);
         // FIXME For the moment we fix the albedo of triangle mesh to be 1
-        interaction->albedo = Spectrum(1.f);
+        interaction->albedo = TSpectrum<T>(1.f);
 
         return true;
     }
 
-    bool Triangle::IntersectP(Ray const &ray) const {
+    template<typename T>
+    bool Triangle::RayIntersectP(TRay<T> const &ray) const {
         // Get vertices from mesh
         Vector3f const &v0 = mesh.vertices[mesh.triangles[triangle_index].v[0]];
         Vector3f const &v1 = mesh.vertices[mesh.triangles[triangle_index].v[1]];
@@ -106,6 +110,22 @@ namespace drdemo {
         return (t > ray.t_min && t < ray.t_max);
     }
 
+    bool Triangle::Intersect(Ray const &ray, Interaction *const interaction) const {
+        return RayIntersect(ray, interaction);
+    }
+
+    bool Triangle::IntersectP(Ray const &ray) const {
+        return RayIntersectP(ray);
+    }
+
+    bool Triangle::Intersect(Rayf const &ray, Interactionf *const interaction) const {
+        return RayIntersect(ray, interaction);
+    }
+
+    bool Triangle::IntersectP(Rayf const &ray) const {
+        return RayIntersectP(ray);
+    }
+
     BBOX Triangle::BBox() const {
         // Get vertices from mesh
         Vector3f const &v0 = mesh.vertices[mesh.triangles[triangle_index].v[0]];
@@ -276,6 +296,14 @@ namespace drdemo {
         return bvh.IntersectP(ray);
     }
 
+    bool TriangleMesh::Intersect(Rayf const &ray, Interactionf *const interaction) const {
+        return bvh.Intersect(ray, interaction);
+    }
+
+    bool TriangleMesh::IntersectP(Rayf const &ray) const {
+        return bvh.IntersectP(ray);
+    }
+
     BBOX TriangleMesh::BBox() const {
         // Return BBOX from BVH acceleration structure
         return bvh.BBox();
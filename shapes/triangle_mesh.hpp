@@ -47,6 +47,13 @@ namespace drdemo {
         // Index of the triangle data
         uint32_t const triangle_index;
 
+        // Intersection routines for the Float and the passive rays
+        template<typename T>
+        bool RayIntersect(TRay<T> const &ray, TInteraction<T> *interaction) const;
+
+        template<typename T>
+        bool RayIntersectP(TRay<T> const &ray) const;
+
     public:
         Triangle(TriangleMesh &mesh, uint32_t t_i);
 
@@ -55,6 +62,10 @@ namespace drdemo {
 
         bool IntersectP(Ray const &ray) const override;
 
+        bool Intersect(Rayf const &ray, Interactionf *interaction) const override;
+
+        bool IntersectP(Rayf const &ray) const override;
+
         BBOX BBox() const override;
 
         Vector3f Centroid() const override;
@@ -114,6 +125,10 @@ namespace drdemo {
 
         bool IntersectP(Ray const &ray) const override;
 
+        bool Intersect(Rayf const &ray, Interactionf *interaction) const override;
+
+        bool IntersectP(Rayf const &ray) const override;
+
         BBOX BBox() const override;
 
         Vector3f Centroid() const override;
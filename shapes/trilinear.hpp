@@ -0,0 +1,296 @@
+#ifndef DRDEMO_TRILINEAR_HPP
+#define DRDEMO_TRILINEAR_HPP
+
+#include <algorithm>
+#include <cmath>
+#include "geometry.hpp"
+#include "bbox.hpp"
+#include "interaction.hpp"
+
+namespace drdemo {
+
+    /**
+     * Trilinear interpolation of the values at the eight vertices of a voxel, shared by the grid shapes.
+     * The vertices start from the corner with the smallest (x,y,z) coordinates and then follow the x, y, z order
+     */
+
+    // Trilinear interpolation of the eight values at the vertices of a voxel, in the order above,
+    // given the local coordinates t of point p inside the voxel. The interpolation is recorded as a single node that
+    // depends on the eight values and on the coordinates of the point
+    inline Float TrilinearNode(Float const *const *values, Vector3F const &p, Vector3f const &t,
+                               Vector3f const &inv_width) {
+        const float w_x[2] = {1.f - t.x, t.x};
+        const float w_y[2] = {1.f - t.y, t.y};
+        const float w_z[2] = {1.f - t.z, t.z};
+        const float sign[2] = {-1.f, 1.f};
+
+        float value = 0.f;
+        float partials[11] = {0.f};
+        for (int i = 0; i < 8; i++) {
+            const int ix = i & 1, iy = (i >> 1) & 1, iz = i >> 2;
+            const float v = values[i]->GetValue();
+            // Derivative with respect to the vertex value is its interpolation weight
+            partials[i] = w_x[ix] * w_y[iy] * w_z[iz];
+            value += partials[i] * v;
+            // Accumulate derivatives with respect to the local coordinates
+            partials[8] += sign[ix] * w_y[iy] * w_z[iz] * v;
+            partials[9] += w_x[ix] * sign[iy] * w_z[iz] * v;
+            partials[10] += w_x[ix] * w_y[iy] * sign[iz] * v;
+        }
+        partials[8] *= inv_width.x;
+        partials[9] *= inv_width.y;
+        partials[10] *= inv_width.z;
+
+        Float const *const parents[11] = {values[0], values[1], values[2], values[3],
+                                          values[4], values[5], values[6], values[7], &p.x, &p.y, &p.z};
+
+        return FusedNode(value, 11, partials, parents);
+    }
+
+    // Trilinear interpolation of eight float values, in the order above
+    inline float Trilinear(float const *values, Vector3f const &t) {
+        const float c01 = (1.f - t.x) * values[0] + t.x * values[1];
+        const float c23 = (1.f - t.x) * values[2] + t.x * values[3];
+        const float c45 = (1.f - t.x) * values[4] + t.x * values[5];
+        const float c67 = (1.f - t.x) * values[6] + t.x * values[7];
+        const float c0 = (1.f - t.y) * c01 + t.y * c23;
+        const float c1 = (1.f - t.y) * c45 + t.y * c67;
+
+        return (1.f - t.z) * c0 + t.z * c1;
+    }
+
+    // Gradient of the trilinear interpolation of eight float values, in the order above, with respect to the position
+    // of the point, given its local coordinates t inside the voxel
+    inline Vector3f TrilinearGradient(float const *values, Vector3f const &t, Vector3f const &inv_width) {
+        const float w[3][2] = {{1.f - t.x, t.x}, {1.f - t.y, t.y}, {1.f - t.z, t.z}};
+        const float sign[2] = {-1.f, 1.f};
+
+        float gradient[3] = {0.f, 0.f, 0.f};
+        for (int i = 0; i < 8; i++) {
+            const int ix = i & 1, iy = (i >> 1) & 1, iz = i >> 2;
+            gradient[0] += sign[ix] * w[1][iy] * w[2][iz] * values[i];
+            gradient[1] += w[0][ix] * sign[iy] * w[2][iz] * values[i];
+            gradient[2] += w[0][ix] * w[1][iy] * sign[iz] * values[i];
+        }
+
+        return Vector3f(gradient[0] * inv_width.x, gradient[1] * inv_width.y, gradient[2] * inv_width.z);
+    }
+
+    // Gradient of the trilinear interpolation of the eight values at the vertices of a voxel, in the order above, at
+    // point p with local coordinates t. Each component is recorded as a single node that depends on the eight values
+    // and on the coordinates of p along the other two axes, the interpolation is linear along each axis
+    inline Vector3F TrilinearGradientNode(Float const *const *values, Vector3F const &p, Vector3f const &t,
+                                          Vector3f const &inv_width) {
+        const float w[3][2] = {{1.f - t.x, t.x}, {1.f - t.y, t.y}, {1.f - t.z, t.z}};
+        const float sign[2] = {-1.f, 1.f};
+        Float const *const p_coords[3] = {&p.x, &p.y, &p.z};
+
+        Float components[3];
+        for (int axis = 0; axis < 3; axis++) {
+            const int a = (axis + 1) % 3, b = (axis + 2) % 3;
+            float value = 0.f;
+            float partials[10] = {0.f};
+            for (int i = 0; i < 8; i++) {
+                const int corner[3] = {i & 1, (i >> 1) & 1, i >> 2};
+                const float v = values[i]->GetValue();
+                // Derivative with respect to the vertex value
+                partials[i] = sign[corner[axis]] * w[a][corner[a]] * w[b][corner[b]] * inv_width[axis];
+                value += partials[i] * v;
+                // Mixed second derivatives with respect to the other two coordinates
+                partials[8] += sign[corner[axis]] * sign[corner[a]] * w[b][corner[b]] * v;
+                partials[9] += sign[corner[axis]] * w[a][corner[a]] * sign[corner[b]] * v;
+            }
+            partials[8] *= inv_width[axis] * inv_width[a];
+            partials[9] *= inv_width[axis] * inv_width[b];
+
+            Float const *const parents[10] = {values[0], values[1], values[2], values[3], values[4], values[5],
+                                              values[6], values[7], p_coords[a], p_coords[b]};
+            components[axis] = FusedNode(value, 10, partials, parents);
+        }
+
+        return Vector3F(components[0], components[1], components[2]);
+    }
+
+    // Real roots of c3 x^3 + c2 x^2 + c1 x + c0 in increasing order, returns their number. The coefficients much
+    // smaller than the largest one are dropped, so the polynomial should be scaled so that x is of the order of one
+    inline int SolveCubic(double c3, double c2, double c1, double c0, double *const roots) {
+        const double scale = std::max(std::max(std::abs(c3), std::abs(c2)), std::max(std::abs(c1), std::abs(c0)));
+        const double eps = 1e-7 * scale;
+        int num_roots;
+        if (std::abs(c3) <= eps) {
+            if (std::abs(c2) <= eps) {
+                if (std::abs(c1) <= eps) { return 0; }
+                roots[0] = -c0 / c1;
+                return 1;
+            }
+            // Quadratic, avoiding the cancellation between -c1 and the square root of the discriminant
+            const double disc = c1 * c1 - 4. * c2 * c0;
+            if (disc < 0.) { return 0; }
+            const double q = -0.5 * (c1 + std::copysign(std::sqrt(disc), c1));
+            roots[0] = q / c2;
+            roots[1] = q != 0. ? c0 / q : roots[0];
+            num_roots = 2;
+        } else {
+            // Cubic, trigonometric solution if there are three real roots and Cardano's formula otherwise
+            const double a = c2 / c3, b = c1 / c3, c = c0 / c3;
+            const double q = (a * a - 3. * b) / 9.;
+            const double r = (2. * a * a * a - 9. * a * b + 27. * c) / 54.;
+            if (r * r < q * q * q) {
+                const double theta = std::acos(r / std::sqrt(q * q * q));
+                const double sqrt_q = std::sqrt(q);
+                for (int k = 0; k < 3; ++k) {
+                    roots[k] = -2. * sqrt_q * std::cos((theta + 2. * k * M_PI) / 3.) - a / 3.;
+                }
+                num_roots = 3;
+            } else {
+                const double A = -std::copysign(std::cbrt(std::abs(r) + std::sqrt(r * r - q * q * q)), r);
+                const double B = A != 0. ? q / A : 0.;
+                roots[0] = A + B - a / 3.;
+                return 1;
+            }
+        }
+        std::sort(roots, roots + num_roots);
+        return num_roots;
+    }
+
+    // First zero of the trilinear interpolation of eight float values, in the order above, along the segment
+    // a + u * b of local coordinates with u in [0, 1]. Along a line the interpolation is a cubic in u, solved
+    // analytically. Returns false if there is no zero, a segment starting at a negative value has a zero at u = 0
+    inline bool TrilinearSegmentRoot(float const *const values, Vector3f const &a, Vector3f const &b,
+                                     float *const u) {
+        // Expand the weight of each vertex, a product of three linear polynomials in u, and sum the cubics
+        double c[4] = {0., 0., 0., 0.};
+        for (int i = 0; i < 8; i++) {
+            const int ix = i & 1, iy = (i >> 1) & 1, iz = i >> 2;
+            const double x0 = ix ? a.x : 1. - a.x, x1 = ix ? b.x : -b.x;
+            const double y0 = iy ? a.y : 1. - a.y, y1 = iy ? b.y : -b.y;
+            const double z0 = iz ? a.z : 1. - a.z, z1 = iz ? b.z : -b.z;
+            c[0] += values[i] * x0 * y0 * z0;
+            c[1] += values[i] * (x1 * y0 * z0 + x0 * y1 * z0 + x0 * y0 * z1);
+            c[2] += values[i] * (x1 * y1 * z0 + x1 * y0 * z1 + x0 * y1 * z1);
+            c[3] += values[i] * x1 * y1 * z1;
+        }
+        if (c[0] <= 0.) {
+            *u = 0.f;
+            return true;
+        }
+
+        double roots[3];
+        const int num_roots = SolveCubic(c[3], c[2], c[1], c[0], roots);
+        for (int k = 0; k < num_roots; ++k) {
+            if (roots[k] < -1e-6 || roots[k] > 1. + 1e-6) { continue; }
+            // Polish the root with a Newton step on the full cubic
+            double x = roots[k];
+            const double f = ((c[3] * x + c[2]) * x + c[1]) * x + c[0];
+            const double df = (3. * c[3] * x + 2. * c[2]) * x + c[1];
+            if (df != 0.) { x -= f / df; }
+            *u = static_cast<float>(Clamp(x, 0., 1.));
+            return true;
+        }
+        // The solution can miss a root at the end of the segment by round off, the sign change says it is there
+        const double end_value = c[3] + c[2] + c[1] + c[0];
+        if (end_value <= 0.) {
+            *u = static_cast<float>(c[0] / (c[0] - end_value));
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * Finite differences and sphere tracing shared by the grid shapes
+     */
+
+    // Finite difference weights along an axis, second order backward and forward at the sides of the grid and central
+    // inside, in units of the inverse voxel size
+    const float BACKWARD_DIFFERENCE[3] = {1.5f, -2.f, 0.5f};
+    const float FORWARD_DIFFERENCE[3] = {-1.5f, 2.f, -0.5f};
+    const float CENTRAL_DIFFERENCE[2] = {0.5f, -0.5f};
+
+    // Offsets along an axis of the points of the finite difference at coordinate c of n along it, and their weights
+    // given the inverse voxel size along the axis. Returns the number of points
+    inline int DifferenceOffsets(int c, int n, float inv_width, int *const offsets, float *const weights) {
+        if (c == n - 1) {
+            // Use backward second order to compute derivative
+            for (int i = 0; i < 3; i++) {
+                offsets[i] = -i;
+                weights[i] = BACKWARD_DIFFERENCE[i] * inv_width;
+            }
+            return 3;
+        } else if (c == 0) {
+            // Use forward second order difference
+            for (int i = 0; i < 3; i++) {
+                offsets[i] = i;
+                weights[i] = FORWARD_DIFFERENCE[i] * inv_width;
+            }
+            return 3;
+        }
+        // Use central difference
+        offsets[0] = 1;
+        offsets[1] = -1;
+        weights[0] = CENTRAL_DIFFERENCE[0] * inv_width;
+        weights[1] = CENTRAL_DIFFERENCE[1] * inv_width;
+        return 2;
+    }
+
+    // Ray march inside the bounds of a grid. value_at gives the distance from the surface at a point and skip_distance
+    // how far the ray can go from a depth without looking at the values, zero if it cannot skip anything. Returns true
+    // and the depth of the first point closer to the surface than min_dist if there is one
+    template<typename T, typename ValueAt, typename SkipDistance>
+    inline bool SphereTraceDepth(TRay<T> const &ray, BBOX const &bounds, float min_dist, ValueAt const &value_at,
+                                 SkipDistance const &skip_distance, T *const hit_depth) {
+        // Clip the ray to the grid bounds, outside them there is no surface
+        float t_enter, t_exit;
+        if (!bounds.Intersect(ray, &t_enter, &t_exit)) { return false; }
+        t_exit = std::min(t_exit, MAX_DIST);
+
+        // Current depth, the marching starts where the ray enters the grid
+        T depth(t_enter);
+
+        for (int steps = 0; steps < MAX_STEPS; steps++) {
+            // Jump over the space far from the surface without looking at the grid values
+            const float skip = skip_distance(Tofloat(depth));
+            if (skip > 0.f) {
+                depth += skip;
+                if (depth > t_exit) { return false; }
+                continue;
+            }
+            // Compute distance from surface
+            const T distance = value_at(ray(depth));
+            // Check if we are close enough to the surface
+            if (distance < min_dist) {
+                *hit_depth = depth;
+                return true;
+            }
+            // Increase distance
+            depth += distance;
+            // Check for end
+            if (depth > t_exit) { return false; }
+        }
+        return false;
+    }
+
+    // Fill the interaction of a grid hit at the given depth along the ray, normal_at gives the gradient of the grid
+    template<typename T, typename NormalAt>
+    inline void FillGridInteraction(TRay<T> const &ray, T const &depth, NormalAt const &normal_at,
+                                    TInteraction<T> *const interaction) {
+        // Fill interaction
+        interaction->p = ray(depth);
+
+        // Estimate normal
+        interaction->n = Normalize(normal_at(interaction->p));
+
+        // Interaction parameter
+        interaction->t = depth;
+
+        // Outgoing direction
+        interaction->wo = -Normalize(ray.d);
+        // Set albedo to 1
+        interaction->albedo = TSpectrum<T>(1.f); // FIXME Hardcoded for the moment
+
+        // Shorten the ray like the other shapes do, so the shapes intersected next only report closer hits
+        ray.t_max = depth;
+    }
+
+} // drdemo namespace
+
+#endif //DRDEMO_TRILINEAR_HPP
@@ -105,7 +105,7 @@ namespace drdemo {
 //                    // Compute point coordinates
 //                    const Vector3f p = grid->CoordsAt(x, y, z);
 //                    // Set SDF value
-//                    grid->operator()(x, y, z) = Length(p) - 0.05f;
+//                    grid->SetValue(x, y, z, Length(p) - 0.05f);
 //                }
 //            }
 //        }
@@ -160,6 +160,8 @@ namespace drdemo {
             // Compute new grid resolution
             for (int i = 0; i < 3; i++) { new_dims[i] = (int) (grid->Size(i) * res_multiplier); }
             std::cout << "Grid resolution: " << new_dims[0] << "x" << new_dims[1] << "x" << new_dims[2] << std::endl;
+            // The gradient steps drift the values away from a distance field, fix them before resampling
+            grid->Redistance();
             // Refine grid
             grid->Refine(new_dims);
             // Rebind variables
@@ -0,0 +1,80 @@
+#include <chrono>
+#include <box_film.hpp>
+#include <scene.hpp>
+#include <direct_integrator.hpp>
+#include <simple_renderer.hpp>
+#include <ambient_light.hpp>
+#include <derivative.hpp>
+#include <dual.hpp>
+#include <test_common.hpp>
+#include "dual_light_test.hpp"
+
+namespace drdemo {
+
+    void DualAmbientLightTest(float r, float g, float b) {
+        // Load the first view and create the scene
+        const DinoView view = LoadDinoView();
+        const size_t width = view.width;
+        const size_t height = view.height;
+        const std::vector<float> &target_view = view.target;
+        const PerspectiveCamera &camera = *view.camera;
+        auto light = std::make_shared<AmbientLight>(Spectrum(r, g, b));
+        Scene scene;
+        scene.AddShape(view.grid);
+        scene.AddLight(light);
+        SimpleRenderer renderer(std::make_shared<DirectIntegrator>());
+
+        // Reverse mode, record the render and the image energy on the tape and sweep it back
+        default_tape.Push();
+        auto start = std::chrono::steady_clock::now();
+        BoxFilterFilm render(width, height);
+        renderer.RenderImage(&render, scene, camera);
+        const Float E = render.SquaredDifference(target_view, 0, height);
+        Derivatives derivatives;
+        derivatives.ComputeDerivatives(E);
+        const float tape_gradient[3] = {derivatives.Dwrt(E, light->intensity.r),
+                                        derivatives.Dwrt(E, light->intensity.g),
+                                        derivatives.Dwrt(E, light->intensity.b)};
+        const double tape_time = ElapsedSeconds(start);
+        default_tape.Pop();
+
+        // Forward mode, a passive render where only the intensity of the light carries the three tangent directions.
+        // The shading is the one of the DirectIntegrator with the radiance of the light sampled as Dual3
+        using Dual3 = Dual<3>;
+        default_tape.Disable();
+        start = std::chrono::steady_clock::now();
+        const Vector3f look_dir = Tofloat(camera.LookDir());
+        auto sample_li = [&light](LightInterface const &, Interactionf const &interaction, Vector3f *wi, float *pdf) {
+            return light->SampleLiDual<3>(interaction, 0, wi, pdf);
+        };
+        Dual3 E_dual;
+        for (size_t j = 0; j < height; j++) {
+            for (size_t i = 0; i < width; i++) {
+                TSpectrum<Dual3> L;
+                Interactionf interaction;
+                if (scene.Intersect(camera.GenerateRayf(i, j, 0.5f, 0.5f), &interaction)) {
+                    L = DirectIntegrator::Shade<Dual3>(interaction, scene, look_dir, sample_li);
+                }
+                const size_t index = j * width + i;
+                E_dual += Norm(L - TSpectrum<Dual3>(target_view[3 * index], target_view[3 * index + 1],
+                                                    target_view[3 * index + 2]));
+            }
+        }
+        const double dual_time = ElapsedSeconds(start);
+        default_tape.Enable();
+
+        float max_difference = 0.f;
+        for (size_t k = 0; k < 3; k++) {
+            max_difference = std::max(max_difference, std::abs(E_dual.Tangent(k) - tape_gradient[k]) /
+                                                      std::max(1.f, std::abs(tape_gradient[k])));
+        }
+
+        std::cout << "Energy tape: " << E.GetValue() << ", dual: " << E_dual.GetValue() << std::endl;
+        std::cout << "Gradient tape: " << tape_gradient[0] << " " << tape_gradient[1] << " " << tape_gradient[2]
+                  << " (" << tape_time * 1000.0 << " ms)" << std::endl;
+        std::cout << "Gradient dual: " << E_dual.Tangent(0) << " " << E_dual.Tangent(1) << " " << E_dual.Tangent(2)
+                  << " (" << dual_time * 1000.0 << " ms)" << std::endl;
+        std::cout << "Maximum relative gradient difference: " << max_difference << std::endl;
+    }
+
+} // drdemo namespace
@@ -0,0 +1,14 @@
+#ifndef DRDEMO_DUAL_LIGHT_TEST_HPP
+#define DRDEMO_DUAL_LIGHT_TEST_HPP
+
+namespace drdemo {
+
+    /**
+     * Render the first dino view with an ambient light and compare the derivatives of the image energy with respect
+     * to the light intensity computed forward with Dual<3> during a passive render, with the ones of the tape
+     */
+    void DualAmbientLightTest(float r, float g, float b);
+
+} // drdemo namespace
+
+#endif //DRDEMO_DUAL_LIGHT_TEST_HPP
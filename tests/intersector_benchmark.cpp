@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <chrono>
+#include <grid.hpp>
+#include <test_common.hpp>
+#include "intersector_benchmark.hpp"
+
+namespace drdemo {
+
+    void GridIntersectorBenchmark(int resolution, int repetitions) {
+        // Torus grid and rays of a pinhole looking at it
+        const TorusFixture torus(resolution);
+        SignedDistanceGrid grid(resolution, resolution, resolution, torus.bounds, torus.values.data());
+        const Vector3f &origin = torus.origin;
+        const std::vector<Vector3f> &directions = torus.directions;
+        const double num_rays = static_cast<double>(directions.size()) * repetitions;
+
+        const GridIntersector intersectors[2] = {GridIntersector::SPHERE_TRACING, GridIntersector::DDA};
+        const char *const names[2] = {"Sphere tracing", "DDA"};
+        for (int k = 0; k < 2; k++) {
+            grid.SetIntersector(intersectors[k]);
+
+            // Passive routines
+            auto start = std::chrono::steady_clock::now();
+            for (int r = 0; r < repetitions; r++) {
+                for (Vector3f const &d : directions) {
+                    Interactionf interaction;
+                    grid.Intersect(Rayf(origin, d), &interaction);
+                }
+            }
+            const double passive_time = ElapsedSeconds(start);
+
+            // Passive routines on packets of consecutive pixels of a row
+            start = std::chrono::steady_clock::now();
+            for (int r = 0; r < repetitions; r++) {
+                for (size_t first = 0; first < directions.size(); first += RAY_PACKET_SIZE) {
+                    RayPacketf packet;
+                    packet.size = static_cast<int>(std::min(static_cast<size_t>(RAY_PACKET_SIZE),
+                                                            directions.size() - first));
+                    for (int lane = 0; lane < packet.size; lane++) {
+                        packet.Set(lane, Rayf(origin, directions[first + lane]));
+                    }
+                    Interactionf interactions[RAY_PACKET_SIZE];
+                    bool hits[RAY_PACKET_SIZE];
+                    grid.IntersectPacket(packet, interactions, hits);
+                }
+            }
+            const double packet_time = ElapsedSeconds(start);
+
+            // Recording on the tape with implicit hit derivatives
+            grid.SetHitDerivatives(HitDerivatives::IMPLICIT);
+            const double tape_time = TapeSeconds(repetitions, [&]() {
+                for (Vector3f const &d : directions) {
+                    Interaction interaction;
+                    grid.Intersect(Ray(ToFloat(origin), ToFloat(d)), &interaction);
+                }
+            });
+            grid.SetHitDerivatives(HitDerivatives::MARCHING);
+
+            // Accuracy of the hits
+            size_t hits = 0;
+            double grid_error = 0., max_grid_error = 0., torus_error = 0., max_torus_error = 0.;
+            for (Vector3f const &d : directions) {
+                Interactionf interaction;
+                if (grid.Intersect(Rayf(origin, d), &interaction)) {
+                    const double grid_distance = std::abs(grid.ValueAt(interaction.p));
+                    const double torus_distance = std::abs(TorusDistance(interaction.p));
+                    grid_error += grid_distance;
+                    max_grid_error = std::max(max_grid_error, grid_distance);
+                    torus_error += torus_distance;
+                    max_torus_error = std::max(max_torus_error, torus_distance);
+                    hits++;
+                }
+            }
+
+            std::cout << names[k] << ": " << num_rays / passive_time << " rays/s passive, "
+                      << num_rays / packet_time << " rays/s in packets, "
+                      << num_rays / tape_time << " rays/s on the tape, " << hits << " hits, grid distance at hits "
+                      << grid_error / hits << " mean " << max_grid_error << " max, torus distance "
+                      << torus_error / hits << " mean " << max_torus_error << " max" << std::endl;
+        }
+    }
+
+} // drdemo namespace
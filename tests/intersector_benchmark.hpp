@@ -0,0 +1,15 @@
+#ifndef DRDEMO_INTERSECTOR_BENCHMARK_HPP
+#define DRDEMO_INTERSECTOR_BENCHMARK_HPP
+
+namespace drdemo {
+
+    /**
+     * Trace the same rays through a resolution^3 torus grid with each GridIntersector and print the rays per second,
+     * with the passive routines one ray at a time and in packets and recording on the tape, and the accuracy of the
+     * hits: the interpolated distance at the hit points and their distance from the real torus
+     */
+    void GridIntersectorBenchmark(int resolution, int repetitions);
+
+} // drdemo namespace
+
+#endif //DRDEMO_INTERSECTOR_BENCHMARK_HPP
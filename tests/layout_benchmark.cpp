@@ -0,0 +1,46 @@
+#include <chrono>
+#include <grid.hpp>
+#include <test_common.hpp>
+#include "layout_benchmark.hpp"
+
+namespace drdemo {
+
+    void GridLayoutBenchmark(int resolution, int repetitions) {
+        // Torus grid values and rays of a pinhole looking at it
+        const TorusFixture torus(resolution);
+        const Vector3f &origin = torus.origin;
+        const std::vector<Vector3f> &directions = torus.directions;
+        const double num_rays = static_cast<double>(directions.size()) * repetitions;
+
+        const GridLayout layouts[2] = {GridLayout::LINEAR, GridLayout::BRICKED};
+        const char *const names[2] = {"Linear", "Bricked"};
+        for (int l = 0; l < 2; l++) {
+            const SignedDistanceGrid grid(resolution, resolution, resolution, torus.bounds, torus.values.data(),
+                                          layouts[l]);
+
+            // Passive routines
+            size_t hits = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (int r = 0; r < repetitions; r++) {
+                for (Vector3f const &d : directions) {
+                    Interactionf interaction;
+                    if (grid.Intersect(Rayf(origin, d), &interaction)) { hits++; }
+                }
+            }
+            const double passive_time = ElapsedSeconds(start);
+
+            // Recording on the tape
+            const double tape_time = TapeSeconds(repetitions, [&]() {
+                for (Vector3f const &d : directions) {
+                    Interaction interaction;
+                    grid.Intersect(Ray(ToFloat(origin), ToFloat(d)), &interaction);
+                }
+            });
+
+            std::cout << names[l] << " layout: " << num_rays / passive_time << " rays/s passive, "
+                      << num_rays / tape_time << " rays/s on the tape (" << hits / repetitions << " hits)"
+                      << std::endl;
+        }
+    }
+
+} // drdemo namespace
@@ -0,0 +1,14 @@
+#ifndef DRDEMO_LAYOUT_BENCHMARK_HPP
+#define DRDEMO_LAYOUT_BENCHMARK_HPP
+
+namespace drdemo {
+
+    /**
+     * Trace the same rays through a resolution^3 torus grid stored with each GridLayout and print the rays per second,
+     * with the passive routines and recording on the tape
+     */
+    void GridLayoutBenchmark(int resolution, int repetitions);
+
+} // drdemo namespace
+
+#endif //DRDEMO_LAYOUT_BENCHMARK_HPP
@@ -3,6 +3,7 @@
 //
 
 #include <grid.hpp>
+#include <sparse_grid.hpp>
 #include <scene.hpp>
 #include <clamp_tonemapper.hpp>
 #include <box_film.hpp>
@@ -44,4 +45,36 @@ namespace drdemo {
         default_tape.Enable();
     }
 
+    void LoadAndTestSparseSDF(const std::string &sdf_file_name, int band_voxels, size_t w, size_t h) {
+        // Create SDF from file
+        auto sdf_grid = std::make_shared<SparseSignedDistanceGrid>(sdf_file_name, band_voxels);
+        std::cout << "Stored " << sdf_grid->NumBricks() << " bricks, " << sdf_grid->GetNumVars() << " values" << std::endl;
+
+        // Create scene
+        Scene scene;
+        scene.AddShape(sdf_grid);
+
+        // Create camera
+        auto camera = PinholeCamera(Vector3F(1.f, 2.f, 5.f), Vector3F(), Vector3F(0.f, 1.f, 0.f), 60, w, h);
+
+        // Disable tape
+        default_tape.Disable();
+
+        // Create renderer class with direct illumination integrator
+        auto render = std::make_shared<SimpleRenderer>(std::make_shared<DirectIntegrator>());
+
+        // Create film and tonemapper
+        BoxFilterFilm target(w, h);
+        ClampTonemapper tonemapper;
+
+        // Render camera
+        render->RenderImage(&target, scene, camera);
+
+        // Output image
+        tonemapper.Process("sparse_sdf_render_test.png", target);
+
+        // Re-enable tape
+        default_tape.Enable();
+    }
+
 } // drdemo namespace
\ No newline at end of file
@@ -14,6 +14,11 @@ namespace drdemo {
      */
     void LoadAndTestSDF(const std::string &sdf_file_name, size_t w, size_t h);
 
+    /**
+     * Same as LoadAndTestSDF with a narrow band grid keeping band_voxels voxels around the surface
+     */
+    void LoadAndTestSparseSDF(const std::string &sdf_file_name, int band_voxels, size_t w, size_t h);
+
 } // drdemo namespace
 
 #endif //DRDEMO_SDF_LOADING_RENDER_TEST_HPP
@@ -43,7 +43,7 @@ namespace drdemo {
 //                    // Compute point coordinates
 //                    const Vector3f p = grid->CoordsAt(x, y, z);
 //                    // Set SDF value
-//                    grid->operator()(x, y, z) = Length(p) - start_radius;
+//                    grid->SetValue(x, y, z, Length(p) - start_radius);
 //                }
 //            }
 //        }
@@ -167,7 +167,7 @@ namespace drdemo {
 //                    // Compute point coordinates
 //                    const Vector3f p = grid->CoordsAt(x, y, z);
 //                    // Set SDF value
-//                    grid->operator()(x, y, z) = Length(p) - start_radius;
+//                    grid->SetValue(x, y, z, Length(p) - start_radius);
 //                }
 //            }
 //        }
@@ -296,7 +296,7 @@ namespace drdemo {
 //                    // Compute point coordinates
 //                    const Vector3f p = grid->CoordsAt(x, y, z);
 //                    // Set SDF value
-//                    grid->operator()(x, y, z) = Length(p) - 1.f;
+//                    grid->SetValue(x, y, z, Length(p) - 1.f);
 //                }
 //            }
 //        }
@@ -404,7 +404,7 @@ namespace drdemo {
 //                    // Compute point coordinates
 //                    const Vector3f p = grid->CoordsAt(x, y, z);
 //                    // Set SDF value
-//                    grid->operator()(x, y, z) = Length(p) - 1.f;
+//                    grid->SetValue(x, y, z, Length(p) - 1.f);
 //                }
 //            }
 //        }
@@ -503,7 +503,7 @@ namespace drdemo {
                     // Compute point coordinates
                     const Vector3f p = grid->CoordsAt(x, y, z);
                     // Set SDF value
-                    grid->operator()(x, y, z) = Length(p) - 1.f;
+                    grid->SetValue(x, y, z, Length(p) - 1.f);
                 }
             }
         }
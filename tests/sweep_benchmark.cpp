@@ -0,0 +1,77 @@
+#include <chrono>
+#include <box_film.hpp>
+#include <scene.hpp>
+#include <direct_integrator.hpp>
+#include <simple_renderer.hpp>
+#include <ambient_light.hpp>
+#include <derivative.hpp>
+#include <sweep_tape.hpp>
+#include <test_common.hpp>
+#include "sweep_benchmark.hpp"
+
+namespace drdemo {
+
+    void SweepBenchmark(int repetitions) {
+        // Load the first view and create the scene
+        const DinoView view = LoadDinoView();
+        const size_t width = view.width;
+        const size_t height = view.height;
+        const std::vector<float> &target_view = view.target;
+        const PerspectiveCamera &camera = *view.camera;
+        auto grid = view.grid;
+        Scene scene;
+        scene.AddShape(grid);
+        scene.AddLight(std::make_shared<AmbientLight>(Spectrum(1.f, 1.f, 1.f)));
+        SimpleRenderer renderer(std::make_shared<DirectIntegrator>());
+
+        // Record the render and the image energy on the tape
+        default_tape.Push();
+        BoxFilterFilm render(width, height);
+        renderer.RenderImage(&render, scene, camera);
+        const Float E = render.SquaredDifference(target_view, 0, height);
+        const size_t end = E.NodeIndex() + 1;
+        std::cout << "Recorded tape nodes: " << end << std::endl;
+
+        // Sweep with the Tape layout
+        std::vector<float> adjoints;
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < repetitions; ++r) {
+            adjoints.assign(end, 0.f);
+            adjoints[E.NodeIndex()] = 1.f;
+            Derivatives::Backpropagate(default_tape, end, adjoints);
+        }
+        const double tape_time = ElapsedSeconds(start) / repetitions;
+
+        // Sweep with the structure of arrays layout
+        SweepTape sweep_tape;
+        start = std::chrono::steady_clock::now();
+        sweep_tape.Build(default_tape, end);
+        const double build_time = ElapsedSeconds(start);
+        std::vector<float> sweep_adjoints;
+        start = std::chrono::steady_clock::now();
+        for (int r = 0; r < repetitions; ++r) {
+            sweep_adjoints.assign(end, 0.f);
+            sweep_adjoints[E.NodeIndex()] = 1.f;
+            sweep_tape.Backpropagate(sweep_adjoints);
+        }
+        const double sweep_time = ElapsedSeconds(start) / repetitions;
+        default_tape.Pop();
+
+        // Check that both sweeps computed the same adjoints for the grid variables
+        std::vector<Float const *> vars;
+        grid->GetDiffVariables(vars);
+        float max_difference = 0.f;
+        for (Float const *var : vars) {
+            if (var->NodeIndex() < end) {
+                max_difference = std::max(max_difference,
+                                          std::abs(adjoints[var->NodeIndex()] - sweep_adjoints[var->NodeIndex()]));
+            }
+        }
+
+        std::cout << "Tape sweep: " << tape_time * 1000.0 << " ms" << std::endl;
+        std::cout << "SweepTape build: " << build_time * 1000.0 << " ms, sweep: " << sweep_time * 1000.0 << " ms"
+                  << std::endl;
+        std::cout << "Maximum gradient difference: " << max_difference << std::endl;
+    }
+
+} // drdemo namespace
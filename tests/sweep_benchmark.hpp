@@ -0,0 +1,13 @@
+#ifndef DRDEMO_SWEEP_BENCHMARK_HPP
+#define DRDEMO_SWEEP_BENCHMARK_HPP
+
+namespace drdemo {
+
+    /**
+     * Compare the Tape reverse sweep with the SweepTape one on the tape recorded rendering the first dino view
+     */
+    void SweepBenchmark(int repetitions);
+
+} // drdemo namespace
+
+#endif //DRDEMO_SWEEP_BENCHMARK_HPP
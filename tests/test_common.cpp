@@ -3,6 +3,7 @@
 //
 
 #include <iofile.hpp>
+#include <box_film.hpp>
 #include "test_common.hpp"
 
 namespace drdemo {
@@ -44,4 +45,86 @@ namespace drdemo {
         return points;
     }
 
+    float TorusDistance(Vector3f const &p) {
+        const float ring = std::sqrt(p.x * p.x + p.z * p.z) - 0.6f;
+        return std::sqrt(ring * ring + p.y * p.y) - 0.25f;
+    }
+
+    std::vector<float> TorusGridValues(int resolution) {
+        const float step = 2.f / static_cast<float>(resolution - 1);
+        std::vector<float> values(static_cast<size_t>(resolution) * resolution * resolution);
+        size_t i = 0;
+        for (int z = 0; z < resolution; z++) {
+            for (int y = 0; y < resolution; y++) {
+                for (int x = 0; x < resolution; x++) {
+                    values[i++] = TorusDistance(Vector3f(-1.f + x * step, -1.f + y * step, -1.f + z * step));
+                }
+            }
+        }
+        return values;
+    }
+
+    std::vector<Vector3f> PinholeDirections(Vector3f const &origin, int image_size) {
+        const Vector3f forward = Normalize(-origin);
+        const Vector3f right = Normalize(Cross(forward, Vector3f(0.f, 1.f, 0.f)));
+        const Vector3f up = Cross(right, forward);
+        std::vector<Vector3f> directions;
+        for (int y = 0; y < image_size; y++) {
+            for (int x = 0; x < image_size; x++) {
+                const float u = (x + 0.5f) / image_size - 0.5f, v = (y + 0.5f) / image_size - 0.5f;
+                directions.push_back(Normalize(forward + right * u + up * v));
+            }
+        }
+        return directions;
+    }
+
+    double ElapsedSeconds(std::chrono::steady_clock::time_point const &start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    DinoView LoadDinoView() {
+        DinoView view;
+
+        // Load target image, nothing of it is recorded on the tape
+        const bool tape_enabled = default_tape.IsEnabled();
+        default_tape.Disable();
+        BoxFilterFilm target = BoxFilterFilm::FromPNG("../dinoSparseRing/dinoSR0001.png");
+        view.width = target.Width();
+        view.height = target.Height();
+        view.target = target.Raw();
+        if (tape_enabled) { default_tape.Enable(); }
+
+        // Load camera
+        std::vector<std::string> m_inv_file;
+        float m_inv[9];
+        float c_w[3];
+        if (!ReadFile("../dinoSparseRing/dinoSR_inv_mat.txt", m_inv_file) ||
+            sscanf(m_inv_file[0].c_str(), "%f %f %f %f %f %f %f %f %f %f %f %f",
+                   &m_inv[0], &m_inv[1], &m_inv[2], &m_inv[3], &m_inv[4], &m_inv[5], &m_inv[6], &m_inv[7],
+                   &m_inv[8], &c_w[0], &c_w[1], &c_w[2]) != 12) {
+            std::cerr << "Error parsing camera parameters!" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        view.camera = std::make_shared<PerspectiveCamera>(m_inv, c_w, view.width, view.height);
+
+        view.grid = std::make_shared<SignedDistanceGrid>("../sdfs/dino_watertight_low.sdf");
+
+        return view;
+    }
+
+    TorusFixture::TorusFixture(int resolution)
+            : bounds(Vector3f(-1.f, -1.f, -1.f), Vector3f(1.f, 1.f, 1.f)), values(TorusGridValues(resolution)),
+              origin(0.f, 1.5f, 2.5f), directions(PinholeDirections(origin, 256)) {}
+
+    double TapeSeconds(int repetitions, std::function<void()> const &record) {
+        auto start = std::chrono::steady_clock::now();
+        for (int r = -1; r < repetitions; r++) {
+            if (r == 0) { start = std::chrono::steady_clock::now(); }
+            default_tape.Push();
+            record();
+            default_tape.Pop();
+        }
+        return ElapsedSeconds(start);
+    }
+
 }
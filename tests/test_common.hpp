@@ -5,8 +5,14 @@
 #ifndef DRDEMO_TEST_COMMON_HPP
 #define DRDEMO_TEST_COMMON_HPP
 
+#include <chrono>
+#include <functional>
+#include <memory>
 #include <string>
+#include <vector>
 #include <geometry.hpp>
+#include <perspective_camera.hpp>
+#include <grid.hpp>
 
 namespace drdemo {
 
@@ -16,6 +22,57 @@ namespace drdemo {
     std::vector<Vector3f>
     LoadViewPoints(const std::string &file_name, const char *format, int start_index = 0, int end_index = 0);
 
+    /**
+     * Signed distance of a torus with radii 0.6 and 0.25 around the y axis, and its values at the points of a
+     * resolution^3 grid in the [-1, 1]^3 box in x, y, z order
+     */
+    float TorusDistance(Vector3f const &p);
+
+    std::vector<float> TorusGridValues(int resolution);
+
+    /**
+     * Directions of the rays of a pinhole at origin looking at the center of the world, one per pixel of a square
+     * image
+     */
+    std::vector<Vector3f> PinholeDirections(Vector3f const &origin, int image_size);
+
+    /**
+     * Seconds elapsed since start
+     */
+    double ElapsedSeconds(std::chrono::steady_clock::time_point const &start);
+
+    /**
+     * Target image and camera of the first view of the dino sparse ring, together with the low resolution grid of
+     * the dino
+     */
+    struct DinoView {
+        std::vector<float> target;
+        size_t width, height;
+        std::shared_ptr<const PerspectiveCamera> camera;
+        std::shared_ptr<SignedDistanceGrid> grid;
+    };
+
+    DinoView LoadDinoView();
+
+    /**
+     * Setup of the grid benchmarks, the values of a resolution^3 torus grid in the [-1, 1]^3 box and the rays from a
+     * pinhole looking at it from above at an angle, one per pixel of a 256x256 image
+     */
+    struct TorusFixture {
+        BBOX bounds;
+        std::vector<float> values;
+        Vector3f origin;
+        std::vector<Vector3f> directions;
+
+        explicit TorusFixture(int resolution);
+    };
+
+    /**
+     * Seconds taken by repetitions calls of record, the nodes recorded on the tape by each call are popped. A first
+     * call is not timed so the tape memory is already allocated
+     */
+    double TapeSeconds(int repetitions, std::function<void()> const &record);
+
 } // drdemo namespace
 
 #endif //DRDEMO_TEST_COMMON_HPP
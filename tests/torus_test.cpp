@@ -43,7 +43,7 @@ namespace drdemo {
                     // Compute point coordinates
                     const Vector3f p = grid->CoordsAt(x, y, z);
                     // Set SDF value
-                    grid->operator()(x, y, z) = Length(p) - 1.f;
+                    grid->SetValue(x, y, z, Length(p) - 1.f);
                 }
             }
         }
@@ -0,0 +1,49 @@
+#ifndef DRDEMO_PARALLEL_HPP
+#define DRDEMO_PARALLEL_HPP
+
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace drdemo {
+
+    // Number of threads used by the parallel routines, at least one
+    inline size_t NumThreads() {
+        const unsigned hw_threads = std::thread::hardware_concurrency();
+        return hw_threads == 0 ? 1 : static_cast<size_t>(hw_threads);
+    }
+
+    /**
+     * Split the range [begin, end) in contiguous chunks, one for each thread, and call
+     * func(thread_index, chunk_begin, chunk_end) for each of them. The calling thread processes the first chunk
+     * and the function returns when all chunks are done
+     */
+    template<typename F>
+    void ParallelFor(size_t begin, size_t end, F const &func, size_t num_threads = NumThreads()) {
+        if (end <= begin) { return; }
+        // Never use more threads than elements
+        const size_t range = end - begin;
+        if (num_threads > range) { num_threads = range; }
+        if (num_threads <= 1) {
+            func(0, begin, end);
+            return;
+        }
+        // Size of each chunk, the first ones take one more element if the range does not split evenly
+        const size_t chunk = range / num_threads;
+        const size_t remainder = range % num_threads;
+        std::vector<std::thread> workers;
+        workers.reserve(num_threads - 1);
+        size_t chunk_begin = begin + chunk + (remainder > 0 ? 1 : 0);
+        for (size_t t = 1; t < num_threads; ++t) {
+            const size_t chunk_end = chunk_begin + chunk + (t < remainder ? 1 : 0);
+            workers.emplace_back([&func, t, chunk_begin, chunk_end]() { func(t, chunk_begin, chunk_end); });
+            chunk_begin = chunk_end;
+        }
+        // First chunk on the calling thread
+        func(0, begin, begin + chunk + (remainder > 0 ? 1 : 0));
+        for (auto &worker : workers) { worker.join(); }
+    }
+
+} // drdemo namespace
+
+#endif //DRDEMO_PARALLEL_HPP
@@ -0,0 +1,211 @@
+#include "sdf_file.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SDF_FILE_MMAP
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#endif
+
+namespace drdemo {
+
+    // Magic number at the start of the binary files
+    static const char SDF_FILE_MAGIC[4] = {'D', 'R', 'S', 'F'};
+
+    // Check if the system stores the numbers in little-endian order, the order of the file
+    static bool IsLittleEndian() {
+        const uint32_t one = 1;
+        unsigned char first_byte;
+        std::memcpy(&first_byte, &one, 1);
+        return first_byte == 1;
+    }
+
+    // Reverse the bytes of n 32 bit elements
+    static void SwapBytes(void *elements, size_t n) {
+        auto bytes = static_cast<unsigned char *>(elements);
+        for (size_t i = 0; i < n; ++i, bytes += 4) {
+            std::swap(bytes[0], bytes[3]);
+            std::swap(bytes[1], bytes[2]);
+        }
+    }
+
+    // Swap the numeric fields of the header, it has no padding between them
+    static void SwapHeader(SDFFileHeader *header) {
+        SwapBytes(&header->version, (sizeof(SDFFileHeader) - sizeof(header->magic)) / 4);
+    }
+
+    bool IsBinarySDFFile(std::string const &file_name) {
+        std::ifstream file(file_name, std::ios::binary);
+        char magic[4];
+        return file.read(magic, 4) && std::memcmp(magic, SDF_FILE_MAGIC, 4) == 0;
+    }
+
+    void InitSDFFileHeader(SDFFileHeader *const header) {
+        std::memset(header, 0, sizeof(SDFFileHeader));
+        std::memcpy(header->magic, SDF_FILE_MAGIC, 4);
+        header->version = SDF_FILE_VERSION;
+    }
+
+    bool WriteSDFFile(std::string const &file_name, SDFFileHeader const &header, float const *const values) {
+        const size_t num_values = static_cast<size_t>(header.dims[0]) * header.dims[1] * header.dims[2];
+        std::ofstream file(file_name, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Could not open file: " << file_name << "!" << std::endl;
+            return false;
+        }
+        if (IsLittleEndian()) {
+            file.write(reinterpret_cast<char const *>(&header), sizeof(SDFFileHeader));
+            file.write(reinterpret_cast<char const *>(values), num_values * sizeof(float));
+        } else {
+            SDFFileHeader swapped_header = header;
+            SwapHeader(&swapped_header);
+            file.write(reinterpret_cast<char const *>(&swapped_header), sizeof(SDFFileHeader));
+            std::vector<float> swapped_values(values, values + num_values);
+            SwapBytes(swapped_values.data(), num_values);
+            file.write(reinterpret_cast<char const *>(swapped_values.data()), num_values * sizeof(float));
+        }
+        return static_cast<bool>(file);
+    }
+
+    bool ReadTextSDFFile(std::string const &file_name, SDFFileHeader *const header, std::vector<float> *const values) {
+        std::ifstream file(file_name);
+        if (!file.is_open()) {
+            std::cerr << "Could not open file: " << file_name << "!" << std::endl;
+            return false;
+        }
+        InitSDFFileHeader(header);
+        // Dimensions, minimum point of the bounds and size of the voxels, like the SignedDistanceGrid text loader
+        float voxel_dim;
+        if (!(file >> header->dims[0] >> header->dims[1] >> header->dims[2]) ||
+            !(file >> header->bbox_min[0] >> header->bbox_min[1] >> header->bbox_min[2]) || !(file >> voxel_dim)) {
+            std::cerr << "Error reading .sdf file header" << std::endl;
+            return false;
+        }
+        for (int axis = 0; axis < 3; ++axis) {
+            header->voxel_size[axis] = voxel_dim;
+            header->bbox_max[axis] = header->bbox_min[axis] + voxel_dim * header->dims[axis];
+        }
+        // Read all the values
+        const size_t num_values = static_cast<size_t>(header->dims[0]) * header->dims[1] * header->dims[2];
+        values->resize(num_values);
+        for (size_t i = 0; i < num_values; ++i) {
+            if (!(file >> (*values)[i])) {
+                std::cerr << "Error reading sdf value" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool ConvertSDFToBinary(std::string const &text_file, std::string const &binary_file) {
+        SDFFileHeader header;
+        std::vector<float> values;
+        return ReadTextSDFFile(text_file, &header, &values) && WriteSDFFile(binary_file, header, values.data());
+    }
+
+    MappedSDFFile::MappedSDFFile()
+            : memory(nullptr), size(0), mapped(false) {}
+
+    MappedSDFFile::~MappedSDFFile() {
+        Close();
+    }
+
+    void MappedSDFFile::Close() {
+        if (memory != nullptr) {
+#ifdef SDF_FILE_MMAP
+            if (mapped) { munmap(memory, size); }
+            else { delete[] memory; }
+#else
+            delete[] memory;
+#endif
+        }
+        memory = nullptr;
+        size = 0;
+        mapped = false;
+    }
+
+    bool MappedSDFFile::Open(std::string const &file_name) {
+        Close();
+#ifdef SDF_FILE_MMAP
+        if (IsLittleEndian()) {
+            // Map the file, the values are used in place
+            const int fd = open(file_name.c_str(), O_RDONLY);
+            if (fd < 0) {
+                std::cerr << "Could not open file: " << file_name << "!" << std::endl;
+                return false;
+            }
+            struct stat file_stat;
+            if (fstat(fd, &file_stat) == 0 && static_cast<size_t>(file_stat.st_size) >= sizeof(SDFFileHeader)) {
+                size = static_cast<size_t>(file_stat.st_size);
+                void *const address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (address != MAP_FAILED) {
+                    memory = static_cast<char *>(address);
+                    mapped = true;
+                    // The values are read front to back when the grid is loaded
+                    madvise(address, size, MADV_SEQUENTIAL);
+                }
+            }
+            close(fd);
+        }
+#endif
+        if (memory == nullptr) {
+            // Read the whole file, swapping the numbers to the order of the system
+            std::ifstream file(file_name, std::ios::binary | std::ios::ate);
+            if (!file.is_open()) {
+                std::cerr << "Could not open file: " << file_name << "!" << std::endl;
+                return false;
+            }
+            size = static_cast<size_t>(file.tellg());
+            if (size < sizeof(SDFFileHeader)) {
+                std::cerr << "Binary SDF file too short: " << file_name << "!" << std::endl;
+                Close();
+                return false;
+            }
+            memory = new char[size];
+            file.seekg(0);
+            file.read(memory, size);
+            if (!IsLittleEndian()) {
+                SwapHeader(reinterpret_cast<SDFFileHeader *>(memory));
+                SwapBytes(memory + sizeof(SDFFileHeader), (size - sizeof(SDFFileHeader)) / 4);
+            }
+        }
+
+        // Validate header
+        SDFFileHeader const &header = Header();
+        if (std::memcmp(header.magic, SDF_FILE_MAGIC, 4) != 0 || header.version != SDF_FILE_VERSION) {
+            std::cerr << "Not a supported binary SDF file: " << file_name << "!" << std::endl;
+            Close();
+            return false;
+        }
+        if (header.dims[0] <= 0 || header.dims[1] <= 0 || header.dims[2] <= 0 ||
+            size < sizeof(SDFFileHeader) + NumValues() * sizeof(float)) {
+            std::cerr << "Binary SDF file is truncated: " << file_name << "!" << std::endl;
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    SDFFileHeader const &MappedSDFFile::Header() const {
+        return *reinterpret_cast<SDFFileHeader const *>(memory);
+    }
+
+    float const *MappedSDFFile::Values() const {
+        return reinterpret_cast<float const *>(memory + sizeof(SDFFileHeader));
+    }
+
+    size_t MappedSDFFile::NumValues() const {
+        SDFFileHeader const &header = Header();
+        return static_cast<size_t>(header.dims[0]) * header.dims[1] * header.dims[2];
+    }
+
+} // drdemo namespace
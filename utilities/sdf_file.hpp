@@ -0,0 +1,92 @@
+#ifndef DRDEMO_SDF_FILE_HPP
+#define DRDEMO_SDF_FILE_HPP
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace drdemo {
+
+    /**
+     * Binary signed distance grid format
+     *
+     * The file starts with a fixed size SDFFileHeader followed by the grid values as raw little-endian 32 bit floats
+     * in x, y, z order. The values start at a 64 bytes offset so the file can be memory mapped and read in place
+     */
+
+    // Current version of the binary format
+    const uint32_t SDF_FILE_VERSION = 1;
+
+    struct SDFFileHeader {
+        // Magic number, "DRSF"
+        char magic[4];
+        // Format version
+        uint32_t version;
+        // Number of values along each axis
+        int32_t dims[3];
+        // Bounds of the grid
+        float bbox_min[3];
+        float bbox_max[3];
+        // Size of the voxels
+        float voxel_size[3];
+        // Unused, keeps the values aligned
+        uint32_t reserved[2];
+    };
+
+    static_assert(sizeof(SDFFileHeader) == 64, "The binary SDF header must be 64 bytes long");
+
+    // Check if the file starts with the binary SDF magic number
+    bool IsBinarySDFFile(std::string const &file_name);
+
+    // Fill the magic number and version of a header
+    void InitSDFFileHeader(SDFFileHeader *header);
+
+    // Write header and values to a binary SDF file, returns false if the file could not be written
+    bool WriteSDFFile(std::string const &file_name, SDFFileHeader const &header, float const *values);
+
+    // Read a text SDF file from https://github.com/christopherbatty/SDFGen, the header is filled like the binary one
+    bool ReadTextSDFFile(std::string const &file_name, SDFFileHeader *header, std::vector<float> *values);
+
+    // Convert a text SDF file from https://github.com/christopherbatty/SDFGen to the binary format
+    bool ConvertSDFToBinary(std::string const &text_file, std::string const &binary_file);
+
+    /**
+     * Read only view of a binary SDF file, the file is memory mapped so the values are not copied nor parsed.
+     * The mapping is released when the object is destroyed
+     */
+    class MappedSDFFile {
+    private:
+        // File content and its size
+        char *memory;
+        size_t size;
+        // True if the content is memory mapped, false if it had to be read (big endian systems or no mmap)
+        bool mapped;
+
+        // Release the content
+        void Close();
+
+    public:
+        MappedSDFFile();
+
+        MappedSDFFile(MappedSDFFile const &other) = delete;
+
+        MappedSDFFile &operator=(MappedSDFFile const &other) = delete;
+
+        ~MappedSDFFile();
+
+        // Map the file, returns false if it can not be opened or it is not a valid binary SDF file
+        bool Open(std::string const &file_name);
+
+        // Access header and values of the mapped file
+        SDFFileHeader const &Header() const;
+
+        float const *Values() const;
+
+        // Number of values in the file
+        size_t NumValues() const;
+    };
+
+} // drdemo namespace
+
+#endif //DRDEMO_SDF_FILE_HPP
@@ -8,25 +8,36 @@
 #include <cstdlib>
 #include <cassert>
 #include <algorithm>
+#include <vector>
 
 namespace drdemo {
 
     /**
      * Define custom Tape storage class, used in the RAD toolbox for th Tape class
+     *
+     * The elements are stored in fixed size chunks, growing the storage allocates a new chunk and never moves the
+     * existing elements. Chunks are kept when the storage is cut so they are reused by the following appends
      */
     template<typename T>
     class TapeStorage {
     private:
-        // Maximum storage
-        size_t max_size;
+        // Number of elements in each chunk (power of two) and its log2
+        size_t chunk_size;
+        size_t chunk_shift;
         // Used storage
         size_t size;
-        // Allocated memory
-        T *data;
+        // Allocated chunks
+        std::vector<T *> chunks;
+
+        // Free all the chunks
+        void FreeChunks();
+
+        // Copy content from other storage, assumes this one is empty
+        void CopyFrom(TapeStorage<T> const &other);
 
     public:
-        // Default constructor
-        explicit TapeStorage(size_t start_size);
+        // Default constructor, the chunk size is rounded up to a power of two. No memory is allocated until needed
+        explicit TapeStorage(size_t start_chunk_size);
 
         // Copy constructor
         TapeStorage(TapeStorage<T> const &other);
@@ -44,64 +55,87 @@ namespace drdemo {
         ~TapeStorage();
 
         // Access element by index
-        inline T const &operator[](size_t i) const noexcept { return data[i]; }
+        inline T const &operator[](size_t i) const noexcept { return chunks[i >> chunk_shift][i & (chunk_size - 1)]; }
 
-        inline T &operator[](size_t i) noexcept { return data[i]; }
+        inline T &operator[](size_t i) noexcept { return chunks[i >> chunk_shift][i & (chunk_size - 1)]; }
 
         // Access element with boundaries check
         inline T const &At(size_t i) const {
             assert(i < size);
-            return data[i];
+            return (*this)[i];
         }
 
         inline T &At(size_t i) {
             assert(i < size);
-            return data[i];
+            return (*this)[i];
         }
 
         // Size of the Tape
         inline size_t Size() const noexcept { return size; }
 
+        // Number of elements that can be stored without allocating
+        inline size_t Capacity() const noexcept { return chunks.size() * chunk_size; }
+
         // Add element
-        void Append(T const &element);
+        inline void Append(T const &element) {
+            if (size == Capacity()) {
+                // Add a new chunk, the current elements stay where they are
+                chunks.push_back(new T[chunk_size]);
+            }
+            (*this)[size++] = element;
+        }
 
-        // Cut a chunk of the TapeStorage starting from a given index included
+        // Add n copies of an element, filling a chunk at a time
+        inline void AppendCopies(T const &element, size_t n) {
+            while (n > 0) {
+                if (size == Capacity()) { chunks.push_back(new T[chunk_size]); }
+                const size_t offset = size & (chunk_size - 1);
+                const size_t count = std::min(n, chunk_size - offset);
+                T *const chunk = chunks[size >> chunk_shift];
+                std::fill(chunk + offset, chunk + offset + count, element);
+                size += count;
+                n -= count;
+            }
+        }
+
+        // Cut a chunk of the TapeStorage starting from a given index included, the memory is kept for reuse
         void Cut(size_t start_index);
 
-        // Resize allocated memory to fit current content
+        // Free the chunks not needed by the current content
         void Resize();
     };
 
     template<typename T>
-    TapeStorage<T>::TapeStorage(size_t start_size)
-            : max_size(start_size), size(0), data(new T[max_size]) {}
+    TapeStorage<T>::TapeStorage(size_t start_chunk_size)
+            : chunk_size(1), chunk_shift(0), size(0) {
+        while (chunk_size < start_chunk_size) {
+            chunk_size <<= 1;
+            chunk_shift++;
+        }
+    }
 
     template<typename T>
     TapeStorage<T>::TapeStorage(TapeStorage<T> const &other)
-            : max_size(other.max_size), size(other.size), data(new T[max_size]) {
-        std::copy(other.data, other.data + size, data);
+            : chunk_size(other.chunk_size), chunk_shift(other.chunk_shift), size(0) {
+        CopyFrom(other);
     }
 
     template<typename T>
     TapeStorage<T>::TapeStorage(TapeStorage<T> &&other) noexcept
-            : max_size(other.max_size), size(other.size) {
-        // Acquire memory ownership
-        data = other.data;
+            : chunk_size(other.chunk_size), chunk_shift(other.chunk_shift), size(other.size),
+              chunks(std::move(other.chunks)) {
         // Set other tape to 0
         other.size = 0;
-        other.max_size = 0;
-        other.data = nullptr;
+        other.chunks.clear();
     }
 
     template<typename T>
     TapeStorage<T> &TapeStorage<T>::operator=(TapeStorage<T> const &other) {
         if (this != &other) {
-            size = other.size;
-            max_size = other.max_size;
-            if (data != nullptr) { delete[] data; }
-            // Allocate space
-            data = new T[max_size];
-            std::copy(other.data, other.data + size, data);
+            FreeChunks();
+            chunk_size = other.chunk_size;
+            chunk_shift = other.chunk_shift;
+            CopyFrom(other);
         }
         return *this;
     }
@@ -109,65 +143,59 @@ namespace drdemo {
     template<typename T>
     TapeStorage<T> &TapeStorage<T>::operator=(TapeStorage<T> &&other) noexcept {
         if (this != &other) {
-            assert(max_size == other.max_size);
-            size = other.size;
             // Delete current content
-            delete[] data;
+            FreeChunks();
             // Acquire memory ownership
-            data = other.data;
+            chunk_size = other.chunk_size;
+            chunk_shift = other.chunk_shift;
+            size = other.size;
+            chunks = std::move(other.chunks);
             // Set other tape to 0
-            other.data = nullptr;
             other.size = 0;
-            other.max_size = 0;
+            other.chunks.clear();
         }
         return *this;
     }
 
     template<typename T>
     TapeStorage<T>::~TapeStorage() {
-        if (data != nullptr) {
-            delete[] data;
-        }
+        FreeChunks();
+    }
+
+    template<typename T>
+    void TapeStorage<T>::FreeChunks() {
+        for (T *chunk : chunks) { delete[] chunk; }
+        chunks.clear();
+        size = 0;
     }
 
     template<typename T>
-    void TapeStorage<T>::Append(T const &element) {
-        if (size == max_size) {
-            // Double the tape capacity
-            max_size = max_size * 2;
-            auto new_data = new T[max_size];
-            // Copy current data into new data
-            std::copy(data, data + size, new_data);
-            // Free old data
-            delete[] data;
-            // Set pointer to new allocated space
-            data = new_data;
+    void TapeStorage<T>::CopyFrom(TapeStorage<T> const &other) {
+        assert(chunks.empty());
+        for (size_t start = 0; start < other.size; start += chunk_size) {
+            chunks.push_back(new T[chunk_size]);
+            const size_t chunk_elements = std::min(chunk_size, other.size - start);
+            std::copy(other.chunks[start >> chunk_shift], other.chunks[start >> chunk_shift] + chunk_elements,
+                      chunks.back());
         }
-        // Add new element
-        data[size++] = element;
+        size = other.size;
     }
 
     template<typename T>
     void TapeStorage<T>::Cut(size_t start_index) {
-        assert(start_index < size);
+        assert(start_index <= size);
         // Set size to new start
         size = start_index;
     }
 
     template<typename T>
     void TapeStorage<T>::Resize() {
-        if (size < max_size) {
-            // Set new max size to size
-            max_size = size;
-            // Allocate new space for Tape
-            auto new_data = new T[max_size];
-            // Copy data
-            std::copy(data, data + size, new_data);
-            // Free old data
-            delete[] data;
-            // Set pointer to new allocated space
-            data = new_data;
+        // Number of chunks needed for the current content
+        const size_t used_chunks = (size + chunk_size - 1) >> chunk_shift;
+        for (size_t c = used_chunks; c < chunks.size(); ++c) {
+            delete[] chunks[c];
         }
+        chunks.resize(used_chunks);
     }
 
 } // drdemo namespace